@@ -0,0 +1,42 @@
+import struct
+import sys
+
+# Converts a VMH image to the emulator's binary image format
+# (include/program_image.h): the magic, then segments of
+# <byte address> <word count> <words>, all 32-bit little-endian.
+#
+#   python3 vmh2bin.py main.vmh main.img
+
+__magic = b'ZLIMAGE1'
+
+
+def read_segments(path):
+    segments = []
+    address = 0
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            if line.startswith('@'):
+                address = int(line[1:], 16)
+                segments.append([address, []])
+                continue
+            if not segments or segments[-1][0] + 4 * len(segments[-1][1]) != address:
+                segments.append([address, []])
+            segments[-1][1].append(int(line, 16))
+            address += 4
+    return [s for s in segments if s[1]]
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: vmh2bin.py <in.vmh> <out.img>')
+    with open(sys.argv[2], 'wb') as out:
+        out.write(__magic)
+        for address, words in read_segments(sys.argv[1]):
+            out.write(struct.pack('<II', address, len(words)))
+            out.write(struct.pack('<%dI' % len(words), *words))
+
+if __name__ == '__main__':
+    main()
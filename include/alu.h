@@ -9,8 +9,8 @@
 class ALU
 {
 public:
-    Register execute(Register &a, Register &b, std::vector<bit> alu_op);
-    Register execute_partial(Register &a, Register &b, std::vector<bit> alu_op);
+    Register execute(Register &a, Register &b, const std::vector<bit> &alu_op);
+    Register execute_partial(Register &a, Register &b, const std::vector<bit> &alu_op);
     Register add(Register &ret, Register a, Register b);
     Register subtract(Register &result, Register a, Register b);
 
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "full_sys.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// --batch: many program images run in one process, each on a ZeroLoop of
+// its own, spread over a pool of worker threads. Every run counts its gates
+// in a sim_context of its own (bit.h); the other state a run accumulates
+// (gate scopes, depths, netlist recording) is per thread. The cost models
+// are parsed once and shared, and so are the zero pages the memories
+// start from.
+struct BatchOptions
+{
+    size_t jobs = 0;               // worker threads, 0 for one per hardware thread
+    std::string out_dir = "batch"; // per program <name>.log and its report, and summary.csv
+};
+
+// One image path per line, relative to the list file; blank lines and '#'
+// comments are skipped. Throws std::runtime_error.
+std::vector<std::string> read_image_list(const std::string &path);
+
+// The program images (*.elf, *.vmh, *.img) of a directory, sorted, or the
+// images of a list file as read by read_image_list
+std::vector<std::string> batch_images(const std::string &list_or_dir);
+
+// Runs every image with options, writing the console output of each to
+// <out_dir>/<name>.log and its run report (--report, JSON by default) next
+// to it. Prints a line per finished program and a summary table, also
+// written to <out_dir>/summary.csv. A program passes if it exited with
+// code 0. Returns 0 if all passed and 1 otherwise.
+int run_batch(const std::vector<std::string> &images, bool ram_accurate, bool with_decoder,
+              const RunOptions &options, const BatchOptions &batch);
+
+// Threads for jobs jobs when jobs threads were asked for (0 for one per
+// hardware thread): never more than there are jobs
+size_t batch_workers(size_t requested, size_t jobs);
+
+// Calls job(index) for every index below jobs on workers threads, which
+// steal queued jobs from each other once their own ran out; returns when
+// all are done. job must not throw.
+void run_jobs(size_t jobs, size_t workers, const std::function<void(size_t)> &job);
@@ -3,12 +3,21 @@
 
 #include "bigint.h"
 #include "bit_cost.h"
+#include "bit_depth.h"
+#include "bit_lanes.h"
+#include "bit_netlist.h"
 
 #include <cassert>
+#include <cstdint>
 #include <bitset>
 #include <vector>
 
-#define bit_slicing 64
+// lanes per bit: 1 for scalar runs, 64 by default, 256/512 for bulk runs
+// (set with make LANES=<n>; AVX2/AVX-512 kernels are used when built with them)
+#ifndef ZEROLOOP_LANES
+#define ZEROLOOP_LANES 64
+#endif
+#define bit_slicing ZEROLOOP_LANES
 
 enum bit_ops_selector {
   bit_ops_cost,
@@ -23,6 +32,7 @@ enum bit_ops_selector {
   bit_ops_nor,
   bit_ops_mux,
   bit_ops_cswap,
+  bit_ops_count
 } ;
 
 const std::vector<bit_ops_selector> bit_ops_selectors = {
@@ -40,37 +50,98 @@ const std::vector<bit_ops_selector> bit_ops_selectors = {
   bit_ops_cswap,
 } ;
 
-class bit {
-  static bigint cost;
-  static bigint numnot;
-  static bigint numxor;
-  static bigint numand;
-  static bigint numor;
-  static bigint numxnor;
-  static bigint numandn;
-  static bigint numnand;
-  static bigint numorn;
-  static bigint numnor;
-  static bigint nummux;
-  static bigint numcswap;
-  std::bitset<bit_slicing> b;
+// gate counter: a plain 64-bit integer on the hot path;
+// wrap-arounds are carried into a bigint, which is only
+// combined with the low word when the counter is read
+class bit_counter {
+  uint64_t lo;
+  bigint wraps;
+  void spill(void);
+public:
+  bit_counter() : lo(0), wraps(0) { }
+  void add(uint64_t n) { lo += n; if (__builtin_expect(lo < n,0)) spill(); }
+  bit_counter &operator+=(uint64_t n) { add(n); return *this; }
+  bit_counter &operator++() { add(1); return *this; }
+  void clear(void) { lo = 0; wraps = 0; }
+  // adds the count of another counter
+  void add(const bit_counter &c) { wraps += c.wraps; add(c.lo); }
+  uint64_t low(void) const { return lo; }
+  bigint value(void) const;
+} ;
+
+// snapshot of the per-type occurrence counts (low 64 bits);
+// differences of two snapshots are exact as long as fewer
+// than 2^64 gates of one type happened in between
+struct bit_ops_counts {
+  uint64_t n[bit_ops_count];
+
+  bit_ops_counts() { for (int t = 0;t < bit_ops_count;++t) n[t] = 0; }
+  uint64_t &operator[](bit_ops_selector t) { return n[t]; }
+  uint64_t operator[](bit_ops_selector t) const { return n[t]; }
+  bit_ops_counts &operator+=(const bit_ops_counts &c)
+  { for (int t = 0;t < bit_ops_count;++t) n[t] += c.n[t]; return *this; }
+  bit_ops_counts &operator-=(const bit_ops_counts &c)
+  { for (int t = 0;t < bit_ops_count;++t) n[t] -= c.n[t]; return *this; }
+  bit_ops_counts operator+(const bit_ops_counts &c) const { bit_ops_counts r = *this; r += c; return r; }
+  bit_ops_counts operator-(const bit_ops_counts &c) const { bit_ops_counts r = *this; r -= c; return r; }
+} ;
+
+// Gate counters of one simulation. Gates are counted in the context that
+// is current on the calling thread: the thread's own one, unless another
+// was made current with sim_context::scope (as every run of --batch does).
+// Several simulations can thus count at once on different threads, and
+// merge adds up the counts of finished ones.
+class sim_context {
 public:
-  static bigint ops(void) { return cost; }
+  bit_counter num[bit_ops_count];
+
+  bit_ops_counts counts(void) const {
+    bit_ops_counts c;
+    for (int t = 0;t < bit_ops_count;++t) c.n[t] = num[t].low();
+    return c;
+  }
+  void clear(void) { for (int t = 0;t < bit_ops_count;++t) num[t].clear(); }
+  void merge(const sim_context &c) { for (int t = 0;t < bit_ops_count;++t) num[t].add(c.num[t]); }
+
+  static sim_context &current(void) {
+    sim_context *c = active;
+    if (__builtin_expect(c == nullptr,0)) c = &thread_default();
+    return *c;
+  }
+
+  // makes c the current context of this thread while the scope lasts
+  class scope {
+    sim_context *saved;
+  public:
+    explicit scope(sim_context &c) : saved(active) { active = &c; }
+    ~scope() { active = saved; }
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+  } ;
+
+private:
+  static thread_local sim_context *active;
+  static sim_context &thread_default(void);
+} ;
+
+// gate counting shared by bits of every lane width, into the current
+// sim_context
+class bit_gates {
+protected:
+  static bit_counter &num(bit_ops_selector t) { return sim_context::current().num[t]; }
+public:
+  // weighted total under the primary cost model (see bit_cost_model.h)
+  static bigint ops(void);
   static bigint ops(bit_ops_selector t) {
-    switch(t) {
-      case bit_ops_not: return numnot;
-      case bit_ops_xor: return numxor;
-      case bit_ops_and: return numand;
-      case bit_ops_or: return numor;
-      case bit_ops_xnor: return numxnor;
-      case bit_ops_andn: return numandn;
-      case bit_ops_nand: return numnand;
-      case bit_ops_orn: return numorn;
-      case bit_ops_nor: return numnor;
-      case bit_ops_mux: return nummux;
-      case bit_ops_cswap: return numcswap;
-      default: return cost;
-    }
+    if (t == bit_ops_cost) return ops();
+    return num(t).value();
+  }
+  static bit_ops_counts counts(void) { return sim_context::current().counts(); }
+  static void count(bit_ops_selector t,uint64_t n = 1) { num(t).add(n); }
+  // replays a recorded set of per-type counts
+  static void count(const bit_ops_counts &c) {
+    bit_counter *n = sim_context::current().num;
+    for (int t = 0;t < bit_ops_count;++t) if (c.n[t]) n[t].add(c.n[t]);
   }
   static const char *opsname(bit_ops_selector t) {
     switch(t) {
@@ -89,54 +160,112 @@ public:
     }
   }
 
-  static void clear_all()
-  {
-    cost = 0;
-    numnot = 0;
-    numxor = 0;
-    numand = 0;
-    numor = 0;
-    numxnor = 0;
-    numandn = 0;
-    numnand = 0;
-    numorn = 0;
-    numnor = 0;
-    nummux = 0;
-    numcswap = 0;
+  static void clear_all() { sim_context::current().clear(); }
+} ;
+
+// depth of the gate r computes (see bit_depth.h); nothing without ZEROLOOP_DEPTH
+#if ZEROLOOP_DEPTH
+#define BIT_DEPTH_GATE(r,...) (r).depth_gate(__VA_ARGS__)
+#else
+#define BIT_DEPTH_GATE(r,...) ((void) 0)
+#endif
+
+// node of the recorded netlist r becomes (see bit_netlist.h); nothing without ZEROLOOP_NETLIST
+#if ZEROLOOP_NETLIST
+#define BIT_NETLIST_GATE(r,...) do { if (bit_wire::recording) (r).netlist_gate(__VA_ARGS__); } while (0)
+#define BIT_NETLIST_CONST(r,v) do { if (bit_wire::recording) (r).netlist_const(v); } while (0)
+#define BIT_NETLIST_FORGET(r) (r).netlist_forget()
+#else
+#define BIT_NETLIST_GATE(r,...) ((void) 0)
+#define BIT_NETLIST_CONST(r,v) ((void) 0)
+#define BIT_NETLIST_FORGET(r) ((void) 0)
+#endif
+
+#define BIT_GATE(r,...) do { BIT_DEPTH_GATE(r,__VA_ARGS__); BIT_NETLIST_GATE(r,__VA_ARGS__); } while (0)
+
+template <size_t lanes>
+class basic_bit : public bit_gates, public bit_depth, public bit_wire {
+  typedef bit_lanes<lanes> L;
+  typename L::type b;
+  struct raw { };
+  basic_bit(raw,const typename L::type &x) : b(x) { }
+public:
+  std::bitset<lanes> value_vector(void) const {
+    std::bitset<lanes> r;
+    for (size_t l = 0;l < lanes;++l) r[l] = L::get(b,l);
+    return r;
+  }
+  bool value(void) const { return L::get(b,0); }
+  // per-lane access, used to load and inspect SIMT batch lanes; no gates
+  bool lane(size_t l) const { assert(l < lanes); return L::get(b,l); }
+  void set_lane(size_t l,bool v) { assert(l < lanes); L::set(b,l,v); BIT_NETLIST_FORGET(*this); }
+  void value_assert_eq(const basic_bit &c) { assert(L::equal(b,c.b)); }
+  // all lanes hold the same value
+  bool uniform(void) const { return L::equal(b,L::broadcast(L::get(b,0))); }
+
+  basic_bit(unsigned long i = 0) : b(L::broadcast(i & 1)) { BIT_NETLIST_CONST(*this,i & 1); }
+  basic_bit(const std::bitset<lanes> &x) : b(L::broadcast(0)) {
+    for (size_t l = 0;l < lanes;++l) if (x[l]) L::set(b,l,1);
   }
 
-  std::bitset<bit_slicing> value_vector(void) const { return b; }
-  bool value(void) const { return b[0]; }
-  void value_assert_eq(const bit &c) { assert(b == c.b); }
-
-  bit(unsigned long i = 0) : b(-(i & 1)) { }
-  bit(std::bitset<bit_slicing> x) : b(x) { }
-
-  bit operator~() const { cost += bit_not_cost; ++numnot; return bit(b ^ std::bitset<bit_slicing>(-(unsigned long long) 1)); }
-  bit operator^(const bit &c) const { cost += bit_xor_cost; ++numxor; return bit(b ^ c.b); }
-  bit operator&(const bit &c) const { cost += bit_and_cost; ++numand; return bit(b & c.b); }
-  bit operator|(const bit &c) const { cost += bit_or_cost; ++numor; return bit(b | c.b); }
-
-  bit xnor(const bit &c) const { cost += bit_xnor_cost; ++numxnor; return bit(~(b ^ c.b)); }
-  bit andn(const bit &c) const { cost += bit_andn_cost; ++numandn; return bit(b & ~c.b); }
-  bit nand(const bit &c) const { cost += bit_nand_cost; ++numnand; return bit(~(b & c.b)); }
-  bit orn(const bit &c) const { cost += bit_orn_cost; ++numorn; return bit(b | ~c.b); }
-  bit nor(const bit &c) const { cost += bit_nor_cost; ++numnor; return bit(~(b | c.b)); }
-
-  bit mux(const bit &c0,const bit &c1) const { cost += bit_mux_cost; ++nummux; return bit(c0.b ^ (b & (c0.b ^ c1.b))); }
-  void cswap(bit &c0,bit &c1) const
-  { cost += bit_cswap_cost; ++numcswap;
-    bit flip = bit(b & (c0.b ^ c1.b));
-    bit t0 = bit(c0.b ^ flip.b); // i.e., this->mux(b0,b1)
-    bit t1 = bit(c1.b ^ flip.b); // i.e., this->mux(b1,b0)
-    c0 = t0;
-    c1 = t1;
+  basic_bit operator~() const { ++num(bit_ops_not); basic_bit r(raw(),L::op_not(b)); BIT_GATE(r,bit_ops_not,*this); return r; }
+  basic_bit operator^(const basic_bit &c) const { ++num(bit_ops_xor); basic_bit r(raw(),L::op_xor(b,c.b)); BIT_GATE(r,bit_ops_xor,*this,c); return r; }
+  basic_bit operator&(const basic_bit &c) const { ++num(bit_ops_and); basic_bit r(raw(),L::op_and(b,c.b)); BIT_GATE(r,bit_ops_and,*this,c); return r; }
+  basic_bit operator|(const basic_bit &c) const { ++num(bit_ops_or); basic_bit r(raw(),L::op_or(b,c.b)); BIT_GATE(r,bit_ops_or,*this,c); return r; }
+
+  basic_bit xnor(const basic_bit &c) const { ++num(bit_ops_xnor); basic_bit r(raw(),L::op_not(L::op_xor(b,c.b))); BIT_GATE(r,bit_ops_xnor,*this,c); return r; }
+  basic_bit andn(const basic_bit &c) const { ++num(bit_ops_andn); basic_bit r(raw(),L::op_andn(b,c.b)); BIT_GATE(r,bit_ops_andn,*this,c); return r; }
+  basic_bit nand(const basic_bit &c) const { ++num(bit_ops_nand); basic_bit r(raw(),L::op_not(L::op_and(b,c.b))); BIT_GATE(r,bit_ops_nand,*this,c); return r; }
+  basic_bit orn(const basic_bit &c) const { ++num(bit_ops_orn); basic_bit r(raw(),L::op_or(b,L::op_not(c.b))); BIT_GATE(r,bit_ops_orn,*this,c); return r; }
+  basic_bit nor(const basic_bit &c) const { ++num(bit_ops_nor); basic_bit r(raw(),L::op_not(L::op_or(b,c.b))); BIT_GATE(r,bit_ops_nor,*this,c); return r; }
+
+  basic_bit mux(const basic_bit &c0,const basic_bit &c1) const
+  { ++num(bit_ops_mux); basic_bit r(raw(),L::op_mux(b,c0.b,c1.b)); BIT_GATE(r,bit_ops_mux,*this,c0,c1); return r; }
+  void cswap(basic_bit &c0,basic_bit &c1) const
+  { ++num(bit_ops_cswap);
+    typename L::type t0 = L::op_mux(b,c0.b,c1.b);
+    typename L::type t1 = L::op_mux(b,c1.b,c0.b);
+#if ZEROLOOP_DEPTH
+    bit_depth d;
+    d.depth_gate(bit_ops_cswap,*this,c0,c1);
+    static_cast<bit_depth &>(c0) = d;
+    static_cast<bit_depth &>(c1) = d;
+#endif
+#if ZEROLOOP_NETLIST
+    if (bit_wire::recording) {
+      // recorded as the two muxes it is made of
+      bit_wire w0,w1;
+      w0.netlist_gate(bit_ops_mux,*this,c0,c1);
+      w1.netlist_gate(bit_ops_mux,*this,c1,c0);
+      static_cast<bit_wire &>(c0) = w0;
+      static_cast<bit_wire &>(c1) = w1;
+    }
+#endif
+    c0.b = t0;
+    c1.b = t1;
   }
 
-  bit operator^=(const bit &c) { *this = *this ^ c; return *this; }
-  bit operator&=(const bit &c) { *this = *this & c; return *this; }
-  bit operator|=(const bit &c) { *this = *this | c; return *this; }
+  // word-level gates over n bits, counted in a single update
+  static void word_not(basic_bit *r,const basic_bit *a,size_t n)
+  { num(bit_ops_not).add(n); for (size_t i = 0;i < n;++i) { BIT_GATE(r[i],bit_ops_not,a[i]); r[i].b = L::op_not(a[i].b); } }
+  static void word_xor(basic_bit *r,const basic_bit *a,const basic_bit *c,size_t n)
+  { num(bit_ops_xor).add(n); for (size_t i = 0;i < n;++i) { BIT_GATE(r[i],bit_ops_xor,a[i],c[i]); r[i].b = L::op_xor(a[i].b,c[i].b); } }
+  static void word_and(basic_bit *r,const basic_bit *a,const basic_bit *c,size_t n)
+  { num(bit_ops_and).add(n); for (size_t i = 0;i < n;++i) { BIT_GATE(r[i],bit_ops_and,a[i],c[i]); r[i].b = L::op_and(a[i].b,c[i].b); } }
+  static void word_or(basic_bit *r,const basic_bit *a,const basic_bit *c,size_t n)
+  { num(bit_ops_or).add(n); for (size_t i = 0;i < n;++i) { BIT_GATE(r[i],bit_ops_or,a[i],c[i]); r[i].b = L::op_or(a[i].b,c[i].b); } }
+  static void word_mux(const basic_bit &s,basic_bit *r,const basic_bit *c0,const basic_bit *c1,size_t n)
+  { num(bit_ops_mux).add(n); for (size_t i = 0;i < n;++i) { BIT_GATE(r[i],bit_ops_mux,s,c0[i],c1[i]); r[i].b = L::op_mux(s.b,c0[i].b,c1[i].b); } }
+
+  basic_bit operator^=(const basic_bit &c) { *this = *this ^ c; return *this; }
+  basic_bit operator&=(const basic_bit &c) { *this = *this & c; return *this; }
+  basic_bit operator|=(const basic_bit &c) { *this = *this | c; return *this; }
 
 } ;
 
+typedef basic_bit<bit_slicing> bit;
+
+static_assert(ZEROLOOP_DEPTH || ZEROLOOP_NETLIST || sizeof(bit) == sizeof(bit_lanes<bit_slicing>::type),
+              "a bit without depth tracking or netlist wires is just its lanes");
+
 #endif
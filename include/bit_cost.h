@@ -18,4 +18,8 @@
 // not=2, nand=3, nor=3, and=4, or=4, mux=7, etc.
 // but to really match hardware also need to account for wiring
 
+// these are the weights of the default cost model; other models
+// (e.g. cost_models/cmos_area.cost) are selected at run time with
+// --cost-model and only change how the counts are reported
+
 #endif
@@ -0,0 +1,38 @@
+#ifndef bit_cost_model_h
+#define bit_cost_model_h
+
+#include <string>
+#include <vector>
+
+#include "bigint.h"
+#include "bit.h"
+
+// Gates are only counted per type while the emulator runs; a cost
+// model assigns a weight to every type and is applied when a total
+// is reported. Several models can be selected for one run.
+class bit_cost_model {
+public:
+  std::string name;
+  uint64_t weight[bit_ops_count];
+  uint64_t delay[bit_ops_count]; // logic delay per gate, for DEPTH builds
+
+  // the compile-time weights of bit_cost.h
+  bit_cost_model();
+
+  // file format: one "<gate> <weight>" pair per line, optionally
+  // a "name <name>" line and "delay <gate> <delay>" lines; '#' starts
+  // a comment; gates that are not listed keep their bit_cost.h weight
+  // and a delay of 1
+  static bit_cost_model from_file(const std::string &path);
+
+  bigint cost(const bit_ops_counts &counts) const;
+  bigint cost(void) const; // of everything counted so far
+
+  // models selected for reporting; the first one is the primary
+  // model used by bit::ops(); with none selected, the defaults
+  static void select(const bit_cost_model &m);
+  static const std::vector<bit_cost_model> &selected(void);
+  static const bit_cost_model &primary(void);
+} ;
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef bit_depth_h
+#define bit_depth_h
+
+// Logic depth carried by every bit (make DEPTH=1, ZEROLOOP_DEPTH=1).
+//
+// A gate output gets depth max(input depths) + the delay of its gate type
+// (from the primary cost model, see bit_cost_model.h). Depth is measured
+// within one cycle: bits carry the stamp of when they were produced, and
+// a bit stamped before the current cycle began (register and memory
+// state) enters a gate at depth 0.
+//
+// Each bit also keeps a depth local to the innermost open measurement
+// (a gate scope), i.e. counted from the inputs of the unit that produced
+// it, so a unit's own depth can be told apart from the logic feeding it.
+//
+// Without ZEROLOOP_DEPTH bit_depth is an empty base of bit and all of
+// this compiles to nothing.
+
+#include <algorithm>
+#include <cstdint>
+
+#ifndef ZEROLOOP_DEPTH
+#define ZEROLOOP_DEPTH 0
+#endif
+
+#if ZEROLOOP_DEPTH
+
+class bit_depth {
+  uint64_t stamp = 0;
+  uint32_t cycle_depth = 0;
+  uint32_t local_depth = 0;
+
+  // per thread, like the gate counters
+  static thread_local uint64_t now;          // latest stamp handed out
+  static thread_local uint64_t cycle_stamp;  // stamp the current cycle began with
+  static thread_local uint64_t local_stamp;  // stamp the innermost measurement began with
+  static thread_local uint64_t cycle_max;
+  static thread_local uint64_t local_max;
+public:
+  static uint64_t delay[]; // per bit_ops_selector
+
+  uint64_t depth_in_cycle(void) const { return stamp >= cycle_stamp ? cycle_depth : 0; }
+  uint64_t depth_in_local(void) const { return stamp >= local_stamp ? local_depth : 0; }
+
+  // output of a gate or circuit whose inputs arrive at cycle/local depth c/l
+  void depth_set(uint64_t c,uint64_t l) {
+    stamp = now;
+    cycle_depth = c;
+    local_depth = l;
+    if (c > cycle_max) cycle_max = c;
+    if (l > local_max) local_max = l;
+  }
+  template <typename... B>
+  void depth_gate(int t,const B &... in) {
+    depth_set(std::max({in.depth_in_cycle()...}) + delay[t],
+              std::max({in.depth_in_local()...}) + delay[t]);
+  }
+
+  // starts a new cycle: everything produced so far enters at depth 0
+  static void depth_cycle(void) { cycle_stamp = local_stamp = ++now; cycle_max = local_max = 0; }
+  static uint64_t depth_cycle_max(void) { return cycle_max; }
+
+  // opens a local measurement, returning what depth_local_end restores
+  struct local { uint64_t stamp, max; };
+  static local depth_local_begin(void) { local saved = { local_stamp, local_max }; local_stamp = ++now; local_max = 0; return saved; }
+  // closes it and returns the deepest local depth reached inside
+  static uint64_t depth_local_end(const local &saved) {
+    uint64_t d = local_max;
+    local_stamp = saved.stamp;
+    local_max = std::max(saved.max, d);
+    return d;
+  }
+} ;
+
+#else
+
+class bit_depth {
+public:
+  static uint64_t delay[];
+
+  uint64_t depth_in_cycle(void) const { return 0; }
+  uint64_t depth_in_local(void) const { return 0; }
+  void depth_set(uint64_t,uint64_t) { }
+  template <typename... B>
+  void depth_gate(int,const B &...) { }
+
+  static void depth_cycle(void) { }
+  static uint64_t depth_cycle_max(void) { return 0; }
+
+  struct local { };
+  static local depth_local_begin(void) { return local(); }
+  static uint64_t depth_local_end(const local &) { return 0; }
+} ;
+
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef bit_lanes_h
+#define bit_lanes_h
+
+// Storage and gate kernels for the lanes of one bit.
+//
+// bit_lanes<N>::type holds N lanes; lanes past N inside the storage are
+// don't-care and are masked off whenever lanes are compared or exported.
+//   1..64 lanes   smallest unsigned integer that fits (1 lane = 1 byte)
+//   k*64 lanes    array of 64-bit words
+//   256 lanes     __m256i when built with AVX2
+//   512 lanes     __m512i with AVX-512F, two __m256i with AVX2
+
+#include <bitset>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+template <size_t N, typename = void>
+struct bit_lanes;
+
+template <size_t N>
+struct bit_lanes<N, typename std::enable_if<(N >= 1 && N <= 64)>::type>
+{
+  typedef typename std::conditional<(N <= 8), uint8_t,
+          typename std::conditional<(N <= 16), uint16_t,
+          typename std::conditional<(N <= 32), uint32_t, uint64_t>::type>::type>::type type;
+
+  static type broadcast(bool v) { return (type) -(type) v; }
+  static type op_not(type a) { return (type) ~a; }
+  static type op_xor(type a,type b) { return a ^ b; }
+  static type op_and(type a,type b) { return a & b; }
+  static type op_or(type a,type b) { return a | b; }
+  static type op_andn(type a,type b) { return a & (type) ~b; }
+  static type op_mux(type s,type c0,type c1) { return c0 ^ (s & (c0 ^ c1)); }
+
+  static bool get(type a,size_t l) { return (a >> l) & 1; }
+  static void set(type &a,size_t l,bool v) { a = (a & (type) ~((type) 1 << l)) | ((type) v << l); }
+  static bool equal(type a,type b)
+  { return N == 8 * sizeof(type) ? a == b : ((a ^ b) & (((type) 1 << (N % (8 * sizeof(type)))) - 1)) == 0; }
+} ;
+
+template <size_t N>
+struct bit_lanes<N, typename std::enable_if<(N > 64 && N % 64 == 0)>::type>
+{
+  struct type { uint64_t w[N / 64]; };
+
+  static type broadcast(bool v) { type r; for (size_t i = 0;i < N / 64;++i) r.w[i] = -(uint64_t) v; return r; }
+  static type op_not(const type &a) { type r; for (size_t i = 0;i < N / 64;++i) r.w[i] = ~a.w[i]; return r; }
+  static type op_xor(const type &a,const type &b) { type r; for (size_t i = 0;i < N / 64;++i) r.w[i] = a.w[i] ^ b.w[i]; return r; }
+  static type op_and(const type &a,const type &b) { type r; for (size_t i = 0;i < N / 64;++i) r.w[i] = a.w[i] & b.w[i]; return r; }
+  static type op_or(const type &a,const type &b) { type r; for (size_t i = 0;i < N / 64;++i) r.w[i] = a.w[i] | b.w[i]; return r; }
+  static type op_andn(const type &a,const type &b) { type r; for (size_t i = 0;i < N / 64;++i) r.w[i] = a.w[i] & ~b.w[i]; return r; }
+  static type op_mux(const type &s,const type &c0,const type &c1)
+  { type r; for (size_t i = 0;i < N / 64;++i) r.w[i] = c0.w[i] ^ (s.w[i] & (c0.w[i] ^ c1.w[i])); return r; }
+
+  static bool get(const type &a,size_t l) { return (a.w[l / 64] >> (l % 64)) & 1; }
+  static void set(type &a,size_t l,bool v)
+  { a.w[l / 64] = (a.w[l / 64] & ~((uint64_t) 1 << (l % 64))) | ((uint64_t) v << (l % 64)); }
+  static bool equal(const type &a,const type &b)
+  { for (size_t i = 0;i < N / 64;++i) if (a.w[i] != b.w[i]) return false; return true; }
+} ;
+
+#ifdef __AVX2__
+
+template <>
+struct bit_lanes<256>
+{
+  typedef __m256i type;
+
+  static type broadcast(bool v) { return _mm256_set1_epi64x(-(long long) v); }
+  static type op_not(type a) { return _mm256_xor_si256(a, _mm256_set1_epi64x(-1)); }
+  static type op_xor(type a,type b) { return _mm256_xor_si256(a, b); }
+  static type op_and(type a,type b) { return _mm256_and_si256(a, b); }
+  static type op_or(type a,type b) { return _mm256_or_si256(a, b); }
+  static type op_andn(type a,type b) { return _mm256_andnot_si256(b, a); }
+  static type op_mux(type s,type c0,type c1)
+  { return _mm256_xor_si256(c0, _mm256_and_si256(s, _mm256_xor_si256(c0, c1))); }
+
+  static bool get(type a,size_t l) { alignas(32) uint64_t w[4]; _mm256_store_si256((__m256i *) w, a); return (w[l / 64] >> (l % 64)) & 1; }
+  static void set(type &a,size_t l,bool v)
+  { alignas(32) uint64_t w[4]; _mm256_store_si256((__m256i *) w, a);
+    w[l / 64] = (w[l / 64] & ~((uint64_t) 1 << (l % 64))) | ((uint64_t) v << (l % 64));
+    a = _mm256_load_si256((const __m256i *) w); }
+  static bool equal(type a,type b) { return _mm256_testz_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(a, b)); }
+} ;
+
+#endif
+
+#if defined(__AVX512F__)
+
+template <>
+struct bit_lanes<512>
+{
+  typedef __m512i type;
+
+  static type broadcast(bool v) { return _mm512_set1_epi64(-(long long) v); }
+  static type op_not(type a) { return _mm512_ternarylogic_epi64(a, a, a, 0x55); }
+  static type op_xor(type a,type b) { return _mm512_xor_si512(a, b); }
+  static type op_and(type a,type b) { return _mm512_and_si512(a, b); }
+  static type op_or(type a,type b) { return _mm512_or_si512(a, b); }
+  static type op_andn(type a,type b) { return _mm512_andnot_si512(b, a); }
+  // one instruction: s ? c1 : c0
+  static type op_mux(type s,type c0,type c1) { return _mm512_ternarylogic_epi64(s, c1, c0, 0xCA); }
+
+  static bool get(type a,size_t l) { alignas(64) uint64_t w[8]; _mm512_store_si512(w, a); return (w[l / 64] >> (l % 64)) & 1; }
+  static void set(type &a,size_t l,bool v)
+  { alignas(64) uint64_t w[8]; _mm512_store_si512(w, a);
+    w[l / 64] = (w[l / 64] & ~((uint64_t) 1 << (l % 64))) | ((uint64_t) v << (l % 64));
+    a = _mm512_load_si512(w); }
+  static bool equal(type a,type b) { return _mm512_cmpneq_epi64_mask(a, b) == 0; }
+} ;
+
+#elif defined(__AVX2__)
+
+template <>
+struct bit_lanes<512>
+{
+  typedef bit_lanes<256> half;
+  struct type { __m256i lo, hi; };
+
+  static type broadcast(bool v) { return { half::broadcast(v), half::broadcast(v) }; }
+  static type op_not(const type &a) { return { half::op_not(a.lo), half::op_not(a.hi) }; }
+  static type op_xor(const type &a,const type &b) { return { half::op_xor(a.lo, b.lo), half::op_xor(a.hi, b.hi) }; }
+  static type op_and(const type &a,const type &b) { return { half::op_and(a.lo, b.lo), half::op_and(a.hi, b.hi) }; }
+  static type op_or(const type &a,const type &b) { return { half::op_or(a.lo, b.lo), half::op_or(a.hi, b.hi) }; }
+  static type op_andn(const type &a,const type &b) { return { half::op_andn(a.lo, b.lo), half::op_andn(a.hi, b.hi) }; }
+  static type op_mux(const type &s,const type &c0,const type &c1)
+  { return { half::op_mux(s.lo, c0.lo, c1.lo), half::op_mux(s.hi, c0.hi, c1.hi) }; }
+
+  static bool get(const type &a,size_t l) { return l < 256 ? half::get(a.lo, l) : half::get(a.hi, l - 256); }
+  static void set(type &a,size_t l,bool v) { if (l < 256) half::set(a.lo, l, v); else half::set(a.hi, l - 256, v); }
+  static bool equal(const type &a,const type &b) { return half::equal(a.lo, b.lo) && half::equal(a.hi, b.hi); }
+} ;
+
+#endif
+
+#endif
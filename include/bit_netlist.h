@@ -0,0 +1,57 @@
+#ifndef bit_netlist_h
+#define bit_netlist_h
+
+// Wire of a bit in a recorded netlist (make NETLIST=1, ZEROLOOP_NETLIST=1);
+// the recorder itself is in netlist.h.
+//
+// While a recording is active every gate becomes a node of the netlist and
+// its output bit remembers the node's wire. Wires are numbered on from one
+// recording to the next, so a bit whose wire predates the active recording
+// (or that never had one) is outside the region: the first time it feeds
+// a gate it becomes an input of the netlist.
+//
+// Without ZEROLOOP_NETLIST bit_wire is an empty base of bit and the hooks
+// compile to nothing.
+
+#include <cstdint>
+#include <initializer_list>
+
+#ifndef ZEROLOOP_NETLIST
+#define ZEROLOOP_NETLIST 0
+#endif
+
+#if ZEROLOOP_NETLIST
+
+class bit_wire {
+  mutable uint64_t wire = 0;
+public:
+  // per thread, like the gate counters
+  static thread_local bool recording;
+  static thread_local uint64_t first; // first wire of the active recording
+
+  // wire in the active recording; a bit from outside becomes an input
+  uint64_t netlist_wire(void) const;
+  void netlist_set(uint64_t w) { wire = w; }
+  // bit now holds something the netlist cannot follow (e.g. a lane set by hand)
+  void netlist_forget(void) { wire = 0; }
+
+  template <typename... B>
+  void netlist_gate(int op,const B &... in) { wire = record(op,{in.netlist_wire()...}); }
+  void netlist_const(bool v) { wire = constant(v); }
+
+  static uint64_t record(int op,std::initializer_list<uint64_t> in);
+  static uint64_t constant(bool v);
+} ;
+
+inline bool netlist_recording(void) { return bit_wire::recording; }
+
+#else
+
+class bit_wire {
+} ;
+
+inline bool netlist_recording(void) { return false; }
+
+#endif
+
+#endif
@@ -12,6 +12,7 @@
 #include <cassert>
 #include <iostream>
 #include <bigint.h>
+#include "bit_cost_model.h"
 
 #include "register.h"
 #include "reg_file.h"
@@ -19,4 +20,9 @@
 #include "pc.h"
 #include "ram_cpu.h"
 #include "decoder.h"
-#include "plugin.h"
\ No newline at end of file
+#include "plugin.h"
+#include "plugin_units.h"
+#include "netlist.h"
+#include "run_report.h"
+#include "profile.h"
+#include "console.h"
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <iostream>
+
+// Stream the output of a run goes to (console output of the program, the
+// exit summary and the tables printed at exit). It is std::cout unless the
+// calling thread redirected it, as the jobs of --batch do to collect the
+// output of each program separately.
+std::ostream &console();
+
+// Redirects console() of the calling thread to out; nullptr restores
+// std::cout
+void set_console(std::ostream *out);
@@ -5,6 +5,7 @@
 #include <string>
 #include <iostream>
 #include "bit_vector.h"
+#include <unordered_map>
 
 
 class Decoder {
@@ -129,5 +130,19 @@ public:
     };
 
     DecodedInstruction decode(uint32_t instruction);
-    
+
+    // Same result and gate counts as decode(), through a PC-indexed cache:
+    // the first time a PC is decoded the circuit is simulated and the gates
+    // it charged are recorded; later decodes of the same word at that PC
+    // replay those counts instead (except in DEPTH builds, which simulate
+    // every decode)
+    const DecodedInstruction &decode_cached(uint32_t pc, uint32_t instruction);
+
+private:
+    struct CachedDecode {
+        uint32_t instruction;
+        DecodedInstruction decoded;
+        bit_ops_counts gates;
+    };
+    std::unordered_map<uint32_t, CachedDecode> decode_cache;
 };
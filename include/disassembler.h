@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// One instruction as text, in the syntax of objdump -d with ABI register
+// names. Covers RV32I, Zicsr and the custom opcodes of this CPU: custom-0
+// (0x0B) plug-in instructions and the custom-1 (0x2B) counters of
+// c/include/measure.h. pc is the byte address of the instruction, for the
+// targets of branches and jumps. Unknown encodings come out as ".word".
+std::string disassemble(uint32_t instruction, uint32_t pc);
@@ -1,19 +1,88 @@
 #pragma once
 
 #include "../include/zero_loop.h"
+#include "program_image.h"
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <stdexcept>
 #include <iostream>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <memory>
 
 extern bigint total_cost;
 
+// Options of a run beyond the positional arguments
+struct RunOptions
+{
+    // SIMT batch mode: one VMH image per lane (at most bit_slicing). All images
+    // must share lane 0's text; each one supplies the data memory of its lane.
+    std::vector<std::string> simt_images;
+
+    // How instruction and data RAMs charge their accesses (see ram_cpu.h)
+    ram_backend ram = ram_analytic;
+
+    // Sizes of the modelled memories in words. Data memory still starts at
+    // DATA_MEM_BASE, so instruction memory is at most INSTR_MEM_SIZE words.
+    size_t instr_mem_words = INSTR_MEM_SIZE;
+    size_t data_mem_words = DATA_MEM_SIZE;
+
+    // Plug-in units loaded from shared objects, as --plugin arguments
+    // (see plugin_units.h)
+    std::vector<std::string> plugins;
+    // What the decoder path charges the plug-in units for instructions
+    // other than custom-0
+    plugin_idle_cost plugin_idle;
+
+    // Check the closed-form RAM costs against the circuit before running
+    bool verify_ram_cost = false;
+
+    // Region to record as a gate netlist (NETLIST=1 builds, see netlist.h),
+    // written to <netlist_out>.bristol and <netlist_out>.blif
+    netlist_region netlist = netlist_off;
+    std::string netlist_out = "netlist";
+
+    // Machine-readable summary written at exit (see run_report.h)
+    report_format report = report_none;
+    std::string report_out; // default report.json / report.csv
+    bool report_append = false; // report_csv: add a row to an existing report_out
+
+    // Gate profile per PC and per function (see profile.h), written to
+    // <profile_out>.folded and <profile_out>.instructions.folded; the
+    // profile_top costliest entries are printed at exit
+    std::string profile_out;
+    size_t profile_top = 20;
+    // Annotated disassembly of the executed instructions, written to this
+    // file at exit; "-" prints it
+    std::string annotate_out;
+
+    // Bounds of the run, 0 for none. A run that reaches one, or that jumps to
+    // itself or fetches outside the loaded text, is stopped with its
+    // run_status (see run_report.h) as the exit status
+    uint64_t max_instructions = 0;
+    uint64_t max_gates = 0; // under the primary cost model
+    double timeout = 0;     // host seconds of execution
+
+    // Loader output: 0 none, 1 a summary per image, 2 every word loaded
+    int verbose = 0;
+};
+
 int32_t register_to_int(Register &reg);
 
-void load_instructions(RAM *instr_mem, RAM *data_mem, const char *file_location, uint32_t data_start_addr = 2048);
+// Loads an ELF, VMH or binary program image (see program_image.h): words
+// below DATA_MEM_BASE into instruction memory, the others into data memory.
+// verbose 1 prints a summary line, 2 every word. Returns the image, for its
+// entry point and symbols.
+ProgramImage load_instructions(RAM *instr_mem, RAM *data_mem, const char *file_location, int verbose = 0);
+
+ProgramImage load_instructions(std::vector<uint32_t> &instr_mem, RAM *data_mem, const char *file_location, int verbose = 0);
 
-void load_instructions(std::vector<uint32_t> &instr_mem, RAM *data_mem, const char *file_location, uint32_t data_start_addr = 2048);
+// Gives every SIMT lane the data section of its own image (no gates)
+void load_simt_lanes(RAM *data_mem, const char *program_location, const std::vector<std::string> &lane_images, int verbose = 0);
 
-void run_full_system(char *instr_location, bool ram_accurate = false, bool with_decoder = true);
+// Runs a program image until it exits or is stopped and returns its report,
+// whose status is the exit status of the emulator. Output goes to console().
+RunReport run_full_system(const char *instr_location, bool ram_accurate = false, bool with_decoder = true, const RunOptions &options = RunOptions());
 
@@ -0,0 +1,117 @@
+#ifndef gate_scope_h
+#define gate_scope_h
+
+// Named, nestable gate-accounting scopes.
+//
+//   GATE_SCOPE("alu");
+//
+// charges every gate counted from there to the end of the enclosing block
+// to a scope "alu" under whichever scope was open when it started; scopes
+// with the same name under the same parent share one node. The resulting
+// tree, with per-gate-type counts, is printed by gate_scope_report.
+//
+// In DEPTH builds (bit_depth.h) a scope is also a unit whose logic depth
+// is measured from its own inputs; the deepest unit depths and critical
+// path of every cycle are collected per kind of cycle (depth_cycle_begin,
+// depth_cycle_end) and printed by depth_report.
+//
+// With ZEROLOOP_GATE_SCOPES=0 (make SCOPES=0) GATE_SCOPE expands to
+// nothing and the report is empty.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "bit.h"
+
+#ifndef ZEROLOOP_GATE_SCOPES
+#define ZEROLOOP_GATE_SCOPES 1
+#endif
+
+// prints the scope tree (nothing if no scope was entered)
+void gate_scope_report(std::ostream &);
+
+// forgets everything recorded so far, e.g. together with bit::clear_all
+void gate_scope_clear(void);
+
+// DEPTH builds: brackets one cycle of the emulated design; label names the
+// kind of cycle (e.g. the instruction class) the depths are reported under
+void depth_cycle_begin(void);
+void depth_cycle_end(const char *label);
+// critical path per kind of cycle, with the unit depths, and the cycle
+// time and throughput they imply for a design running lanes in parallel
+void depth_report(std::ostream &, size_t lanes);
+
+#if ZEROLOOP_GATE_SCOPES
+
+struct gate_scope_node {
+  const char *name;
+  gate_scope_node *parent;
+  std::vector<std::unique_ptr<gate_scope_node>> children;
+  bit_ops_counts total; // inclusive of children, of closed scopes
+  bit_ops_counts start; // counts when the outermost open scope began
+  uint64_t calls = 0;
+  uint64_t open = 0;
+  uint64_t depth = 0;       // deepest unit depth in the current cycle
+  uint64_t depth_cycle = 0; // cycle that depth belongs to
+
+  gate_scope_node(const char *name,gate_scope_node *parent) : name(name), parent(parent) { }
+
+  gate_scope_node *child(const char *child_name) {
+    for (auto &c : children)
+      if (c->name == child_name || !strcmp(c->name,child_name)) return c.get();
+    children.emplace_back(new gate_scope_node(child_name,this));
+    return children.back().get();
+  }
+} ;
+
+class gate_scope {
+  gate_scope_node *node;
+  gate_scope_node *parent;
+#if ZEROLOOP_DEPTH
+  bit_depth::local depth_saved;
+#endif
+public:
+  // one tree per thread, like the gate counters
+  static thread_local gate_scope_node root;
+  static thread_local gate_scope_node *current;
+  static thread_local uint64_t cycle; // numbers the cycles of depth_cycle_begin
+
+  // a scope re-entered while already open (recursion) is only counted once
+  explicit gate_scope(const char *name) : node(current->child(name)), parent(current) {
+    if (node->open++ == 0) node->start = bit::counts();
+    node->calls += 1;
+    current = node;
+#if ZEROLOOP_DEPTH
+    depth_saved = bit_depth::depth_local_begin();
+#endif
+  }
+  ~gate_scope() {
+#if ZEROLOOP_DEPTH
+    uint64_t d = bit_depth::depth_local_end(depth_saved);
+    if (node->depth_cycle != cycle) node->depth = 0;
+    node->depth = std::max(node->depth, d);
+    node->depth_cycle = cycle;
+#endif
+    if (--node->open == 0) node->total += bit::counts() - node->start;
+    current = parent;
+  }
+
+  gate_scope(const gate_scope &) = delete;
+  gate_scope &operator=(const gate_scope &) = delete;
+} ;
+
+#define GATE_SCOPE_CONCAT2(a,b) a##b
+#define GATE_SCOPE_CONCAT(a,b) GATE_SCOPE_CONCAT2(a,b)
+#define GATE_SCOPE(name) gate_scope GATE_SCOPE_CONCAT(gate_scope_,__LINE__)(name)
+
+#else
+
+#define GATE_SCOPE(name) do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef netlist_h
+#define netlist_h
+
+// Gate netlists recorded from the bit operations of a region of the run
+// (make NETLIST=1), exported for external tools:
+//
+//   netlist_recorder::begin();
+//   netlist_recorder::input("a",&a.at(0),a.width());  // optional: names inputs
+//   ... code of the region ...
+//   netlist_recorder::output("y",&y.at(0),y.width()); // optional: the result
+//   netlist n = netlist_recorder::end();
+//   n.write_bristol(out);               // Bristol Fashion (MPC, garbling)
+//   n.write_blif(out,"unit");           // BLIF (ABC, SIS, yosys)
+//
+// Identical gates over identical wires are recorded once (hash-consing).
+// Bits from before the region that were not named as inputs become inputs
+// "x" when they first feed a gate; without outputs the gates whose results
+// nothing in the region used are the outputs.
+//
+// Only simulated gates are recorded: gates charged from closed forms (the
+// analytic RAM, see ram_cpu.h) are counted but missing from the netlist,
+// which write_summary points out.
+
+#include "bit.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// region of a run to record (RunOptions)
+enum netlist_region {
+  netlist_off,
+  netlist_plugin,  // the first custom-0 instruction through the plug-in unit
+  netlist_counter, // the first region of counter 0 (check_for_counter)
+} ;
+
+struct netlist {
+  // node kinds besides the gates, which use their bit_ops_selector
+  enum { node_input = -1, node_zero = -2, node_one = -3 };
+  struct node {
+    int op;
+    uint64_t in[3]; // earlier nodes
+  } ;
+  struct port {
+    std::string name;
+    std::vector<uint64_t> nodes;
+  } ;
+
+  std::vector<node> nodes; // in execution order, i.e. topologically sorted
+  std::vector<port> inputs;
+  std::vector<port> outputs;
+  uint64_t executed = 0;   // gates executed while recording, before sharing
+  bit_ops_counts counted;  // gates charged while recording
+
+  static size_t arity(int op) { return op == bit_ops_not ? 1 : op == bit_ops_mux ? 3 : op < 0 ? 0 : 2; }
+  uint64_t gates(void) const;
+
+  void write_bristol(std::ostream &) const;
+  void write_blif(std::ostream &,const std::string &model) const;
+  // gate and port totals, and what the netlist could not capture
+  void write_summary(std::ostream &) const;
+  // <prefix>.bristol and <prefix>.blif; throws std::runtime_error
+  void save(const std::string &prefix,const std::string &model) const;
+} ;
+
+class netlist_recorder {
+public:
+  // one recording at a time; throws std::runtime_error in builds without
+  // ZEROLOOP_NETLIST or if one is already active
+  static void begin(void);
+  // the n bits at bits become the inputs of a port
+  static void input(const std::string &name,bit *bits,size_t n);
+  static void output(const std::string &name,const bit *bits,size_t n);
+  static netlist end(void);
+} ;
+
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <register.h>
+#include "gate_scope.h"
 
 class PLUGIN
 {
@@ -8,3 +9,61 @@ public:
     Register execute_plug_in_unit(Register &ret, Register a, Register b,
                                   uint32_t funct3, uint32_t funct7, uint32_t opcode);
 };
+
+// Plug-in units can also be built as shared objects and loaded at run time
+// with --plugin (see plugin_units.h), so one emulator binary serves every
+// project: compile the project's plugin.cpp with -DZEROLOOP_PLUGIN_SO
+// -shared -fPIC (make <dir>/plugin.so). This header then defines the entry
+// point, zeroloop_plugin(), which hands the emulator the unit's
+// PLUGIN::execute_plug_in_unit. The unit takes custom-0 instructions whose
+// funct7 is in ZEROLOOP_PLUGIN_FUNCT7_FIRST..LAST (all by default, unless
+// --plugin binds it elsewhere); define them before including this header.
+//
+// Units exchange Registers and count their gates in the emulator's
+// sim_context, so a unit must be built from the same headers and with the
+// same LANES, SCOPES, DEPTH and NETLIST as the emulator. Loading checks
+// both; ZEROLOOP_PLUGIN_ABI changes whenever bit or Register do.
+#define ZEROLOOP_PLUGIN_ABI 1
+
+struct zeroloop_plugin_info
+{
+    uint32_t abi;           // ZEROLOOP_PLUGIN_ABI
+    uint32_t lanes;         // ZEROLOOP_LANES
+    uint32_t gate_scopes;   // ZEROLOOP_GATE_SCOPES
+    uint32_t depth;         // ZEROLOOP_DEPTH
+    uint32_t netlist;       // ZEROLOOP_NETLIST
+    uint32_t register_size; // sizeof(Register)
+    uint32_t funct7_first;  // default binding
+    uint32_t funct7_last;
+    Register (*execute)(Register &ret, Register a, Register b,
+                        uint32_t funct3, uint32_t funct7, uint32_t opcode);
+};
+
+#define ZEROLOOP_PLUGIN_ENTRY "zeroloop_plugin"
+
+#ifdef ZEROLOOP_PLUGIN_SO
+
+#ifndef ZEROLOOP_PLUGIN_FUNCT7_FIRST
+#define ZEROLOOP_PLUGIN_FUNCT7_FIRST 0
+#endif
+#ifndef ZEROLOOP_PLUGIN_FUNCT7_LAST
+#define ZEROLOOP_PLUGIN_FUNCT7_LAST 127
+#endif
+
+static Register zeroloop_plugin_execute(Register &ret, Register a, Register b,
+                                        uint32_t funct3, uint32_t funct7, uint32_t opcode)
+{
+    PLUGIN unit;
+    return unit.execute_plug_in_unit(ret, a, b, funct3, funct7, opcode);
+}
+
+extern "C" const zeroloop_plugin_info *zeroloop_plugin(void)
+{
+    static const zeroloop_plugin_info info = {
+        ZEROLOOP_PLUGIN_ABI, ZEROLOOP_LANES, ZEROLOOP_GATE_SCOPES, ZEROLOOP_DEPTH, ZEROLOOP_NETLIST,
+        sizeof(Register), ZEROLOOP_PLUGIN_FUNCT7_FIRST, ZEROLOOP_PLUGIN_FUNCT7_LAST,
+        zeroloop_plugin_execute};
+    return &info;
+}
+
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "plugin.h"
+
+#include <string>
+#include <vector>
+
+// A plug-in unit loaded from a shared object (--plugin=<file.so>, see
+// plugin.h), bound to the custom-0 instructions whose funct7 is in
+// funct7_first..funct7_last. Instructions no loaded unit is bound to go
+// to the unit linked into the emulator (src/plugin.cpp).
+struct plugin_unit
+{
+    std::string path;
+    uint32_t funct7_first;
+    uint32_t funct7_last;
+    const zeroloop_plugin_info *info;
+};
+
+// Loads the unit of "<file.so>[:<funct7>[-<funct7>]]"; without a binding,
+// the unit takes the funct7 range it declares. A shared object is opened
+// once and stays loaded, so runs on several threads share it. Throws
+// std::runtime_error if the file does not load, has no zeroloop_plugin()
+// entry, was built for another ABI or build configuration, or the binding
+// is malformed.
+plugin_unit load_plugin_unit(const std::string &spec);
+
+// The units of a run; throws std::runtime_error if two bind the same funct7
+std::vector<plugin_unit> load_plugin_units(const std::vector<std::string> &specs);
+
+// The file of a --plugin argument, without its binding
+std::string plugin_unit_path(const std::string &spec);
+
+// What the plug-in units are charged for an instruction that does not use
+// them. The decoder path only runs the units for custom-0 instructions;
+// for every other instruction the units, taken together, are idle.
+enum plugin_idle_policy
+{
+    plugin_idle_last,     // the gates of the last custom-0 instruction, as if evaluated every
+                          // cycle; nothing before the first one
+    plugin_idle_zero,     // nothing: the units are clock-gated
+    plugin_idle_static,   // a declared figure per idle instruction
+    plugin_idle_evaluate, // run the units anyway, on the fields of the instruction (slow)
+};
+
+struct plugin_idle_cost
+{
+    plugin_idle_policy policy = plugin_idle_last;
+    bit_ops_counts gates; // of plugin_idle_static
+};
+
+// "last", "zero", "evaluate", or a figure "<gate>=<n>[,<gate>=<n>...]"
+// (gates as in cost model files); throws std::runtime_error
+plugin_idle_cost parse_plugin_idle(const std::string &arg);
+
+// The argument parse_plugin_idle takes back
+std::string plugin_idle_name(const plugin_idle_cost &idle);
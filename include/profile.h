@@ -0,0 +1,82 @@
+#pragma once
+
+#include "bit.h"
+#include "program_image.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Gate and instruction profile of a run (--profile=<prefix>).
+//
+// Every retired instruction is charged to its PC with the gates it took,
+// split into CPU, memory and plug-in gates, and to the function it is in
+// under the call stack that led there. Calls and returns are recognized
+// from jal/jalr and their link registers, as in the RISC-V return-address
+// stack hints. Functions come from the ELF symbol table; images without
+// symbols name a function by the address it was called at.
+class Profiler
+{
+public:
+    explicit Profiler(const ProgramImage &image);
+
+    // An instruction at byte address pc retired and the next one is at
+    // next_pc; cpu includes plugin, memory is everything else it charged
+    void retire(uint32_t pc, uint32_t instruction, uint32_t next_pc,
+                const bit_ops_counts &cpu, const bit_ops_counts &memory, const bit_ops_counts &plugin);
+
+    // Folded stacks ("main;aes_encrypt;sub_bytes <weight>" per line), for
+    // flamegraph.pl or speedscope, weighted by gates (primary cost model)
+    // or by retired instructions
+    void write_folded(std::ostream &out, bool by_gates) const;
+    // The n costliest functions (self and inclusive) and PCs
+    void write_top(std::ostream &out, size_t n) const;
+    // Every executed instruction in address order, disassembled, with its
+    // executions, gates, gates per execution and CPU/memory/plug-in split
+    void write_annotated(std::ostream &out) const;
+    // <prefix>.folded (gates) and <prefix>.instructions.folded; throws
+    // std::runtime_error
+    void save(const std::string &prefix) const;
+    // write_annotated to path; throws std::runtime_error
+    void save_annotated(const std::string &path) const;
+
+private:
+    struct PcStats
+    {
+        uint64_t instructions = 0;
+        int function = -1; // resolved on first retirement
+        uint32_t instruction = 0;
+        bit_ops_counts cpu, memory, plugin;
+    };
+    // a call stack, as a node of the trie of all stacks seen
+    struct Frame
+    {
+        uint32_t parent;
+        int function;
+        std::unordered_map<int, uint32_t> children;
+        uint64_t instructions = 0; // retired with this exact stack
+        bit_ops_counts gates;
+    };
+    struct Call
+    {
+        uint32_t return_address;
+        uint32_t frame;    // frame of the caller
+        uint32_t function; // callee entry, for images without symbols
+    };
+
+    ProgramImage program; // symbols and entry only
+    std::vector<std::string> functions; // names by id
+    std::unordered_map<std::string, int> function_ids;
+    std::unordered_map<uint32_t, PcStats> pcs;
+    std::vector<Frame> frames; // frames[0] is the root
+    std::vector<Call> calls;
+    uint32_t current_entry;    // entry of the running function (no symbols)
+
+    int function_id(const std::string &name);
+    int function_at(uint32_t pc);
+    uint32_t frame_of(uint32_t caller, int function);
+    uint32_t caller_frame() const { return calls.empty() ? 0 : calls.back().frame; }
+    std::string stack_name(uint32_t frame) const;
+};
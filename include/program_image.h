@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct ProgramSymbol
+{
+    std::string name;
+    uint32_t address;
+    uint32_t size; // 0 for plain labels
+    bool code;     // in an executable section
+};
+
+struct ProgramImage
+{
+    std::vector<std::pair<uint32_t, uint32_t>> words; // (byte address, word), in file order
+    uint32_t entry = 0;                               // byte address execution starts at
+    // (byte address, bytes) that are zero without being in words, such as
+    // .bss; fresh memories read as zero, so loading them takes no writes
+    std::vector<std::pair<uint32_t, uint32_t>> zero;
+    std::vector<ProgramSymbol> symbols; // sorted by address (ELF images only)
+
+    // The innermost sized symbol holding address, or else the closest label
+    // before it; null if there is none
+    const ProgramSymbol *symbol_at(uint32_t address) const;
+};
+
+// Reads a program image; the format is told apart by the first bytes:
+//  - ELF32 little-endian RISC-V executables: the PT_LOAD segments, their
+//    zero-filled tails (.bss), the entry point and the symbol table;
+//  - the binary format below, which c/vmh2bin.py converts VMH files to;
+//  - otherwise VMH text as written by c/objdump2vmh.py: "@<hex byte
+//    address>" lines, each followed by one hex word per line for
+//    consecutive addresses.
+// The file is mapped into memory and parsed in place. Throws
+// std::runtime_error if it cannot be read or is malformed.
+ProgramImage read_program_image(const char *path);
+
+// Binary image: the 8-byte magic, then any number of segments of a 32-bit
+// byte address, a 32-bit word count and that many 32-bit words, all
+// little-endian
+#define PROGRAM_IMAGE_MAGIC "ZLIMAGE1"
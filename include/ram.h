@@ -67,6 +67,23 @@ void ram_write(
   const vector<bit> &,
   const vector<bit> &);
 
+void ram_write_masked(
+  std::vector<std::vector<bit>> &,
+  bigint,
+  bigint,
+  const std::vector<bit> &,
+  bigint,
+  const std::vector<bit> &,
+  const std::vector<bit> &,
+  bit = bit(0),
+  bool = 1);
+
+void ram_write_masked(
+  vector<std::vector<bit>> &,
+  const vector<bit> &,
+  const vector<bit> &,
+  const vector<bit> &);
+
 const vector<bit> ram_read_write(
   std::vector<std::vector<bit>> &,
   bigint,
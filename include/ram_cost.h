@@ -0,0 +1,70 @@
+#ifndef ram_cost_h
+#define ram_cost_h
+
+#include "bit.h"
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Closed forms of the ram_read/ram_write circuits of src/ram.cpp, for N
+// words of width bits addressed by ibits address bits (default: just
+// enough bits for N). The gates depend only on these sizes, not on the
+// address or data, so they are returned per gate type and memoized.
+bit_ops_counts ram_read_cost(uint64_t N, uint64_t width, uint64_t ibits);
+bit_ops_counts ram_read_cost(uint64_t N, uint64_t width);
+bit_ops_counts ram_write_cost(uint64_t N, uint64_t width, uint64_t ibits);
+bit_ops_counts ram_write_cost(uint64_t N, uint64_t width);
+bit_ops_counts ram_write_masked_cost(uint64_t N, uint64_t width, uint64_t enables, uint64_t ibits);
+bit_ops_counts ram_write_masked_cost(uint64_t N, uint64_t width, uint64_t enables);
+
+// Index of the word the mux tree selects for address I: the same split
+// walk as ram_read/ram_write, in O(log N)
+uint64_t ram_leaf(uint64_t N, uint64_t I, uint64_t ibits);
+
+// ram_leaf for the address held in every lane of i; returns true, with
+// only leaves[0] filled in, when all lanes hold the same address
+bool ram_leaves(uint64_t N, const std::vector<bit> &i, uint64_t leaves[bit_slicing]);
+
+// DEPTH builds (bit_depth.h): stamps a word of width bits that went
+// through the read or write tree over N words with the depth of that tree,
+// for the analytic accesses that skip its gates; enable is null for a
+// plain write. No-ops otherwise.
+#if ZEROLOOP_DEPTH
+void ram_read_depth(uint64_t N, const std::vector<bit> &i, bit *word, size_t width);
+void ram_write_depth(uint64_t N, const std::vector<bit> &i, const std::vector<bit> &data,
+                     const std::vector<bit> *enable, bit *word);
+#else
+inline void ram_read_depth(uint64_t, const std::vector<bit> &, bit *, size_t) { }
+inline void ram_write_depth(uint64_t, const std::vector<bit> &, const std::vector<bit> &,
+                            const std::vector<bit> *, bit *) { }
+#endif
+
+// Functional equivalents of ram_read/ram_write/ram_write_masked that charge the closed-form
+// gate counts instead of simulating the circuit; lanes with different
+// addresses each get their own word
+const std::vector<bit> ram_read_analytic(
+  const std::vector<std::vector<bit>> &,
+  const std::vector<bit> &);
+
+void ram_write_analytic(
+  std::vector<std::vector<bit>> &,
+  const std::vector<bit> &,
+  const std::vector<bit> &);
+
+void ram_write_masked_analytic(
+  std::vector<std::vector<bit>> &,
+  const std::vector<bit> &,
+  const std::vector<bit> &,
+  const std::vector<bit> &);
+
+// The leaf update of ram_write_masked without charging gates: copies the
+// enabled parts of data into word, in every lane, or in one lane only
+void ram_merge_masked(bit *word, const std::vector<bit> &data, const std::vector<bit> &enable);
+void ram_merge_masked(bit *word, const std::vector<bit> &data, const std::vector<bit> &enable, size_t lane);
+
+// Cross-checks the formulas and the analytic read/write against the
+// recursive circuit on small sizes; throws std::runtime_error on mismatch
+void ram_cost_verify(std::ostream &);
+
+#endif
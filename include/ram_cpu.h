@@ -1,33 +1,165 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include "ram.h"
+#include "ram_cost.h"
+#include "gate_scope.h"
 #include "bit_vector.h"
 #include "register.h"
 
+// How a RAM charges its accesses. Both give the same data and gate counts:
+// circuit simulates the mux tree of src/ram.cpp over every word, analytic
+// indexes the word directly and charges the closed-form counts of ram_cost.h
+enum ram_backend { ram_analytic, ram_circuit };
+
 class RAM 
 {
 private:
+    // Analytic backend: words stored flat in pages of page_words words,
+    // materialized on their first write. Untouched pages all point to one
+    // shared zero page, so host memory follows the words actually used
+    // while size stays the modelled memory the gates are charged for.
+    static const size_t page_words = 1024;
+    typedef std::vector<bit> page;
+    std::vector<std::shared_ptr<page>> pages;
+
+    // Circuit backend: one vector per word, as ram_read/ram_write expect
     vector<vector<bit>> memory;
+
+    size_t size;
     size_t word_size;
     size_t addr_bits;
+    ram_backend backend;
+
+    // Shared by every RAM of the process, including those of other threads
+    // (--batch); a shared page is only ever copied, never written
+    static std::shared_ptr<page> zero_page(size_t word_size) {
+        static std::mutex lock;
+        static std::map<size_t, std::shared_ptr<page>> zero_pages;
+        std::lock_guard<std::mutex> guard(lock);
+        std::shared_ptr<page> &zero = zero_pages[word_size];
+        if (!zero) zero = std::make_shared<page>(page_words * word_size, bit(0));
+        return zero;
+    }
+
+    const bit *word(uint64_t index) const {
+        return pages[index / page_words]->data() + (index % page_words) * word_size;
+    }
+
+    // Copies the page on first write, or when another RAM still shares it
+    bit *word_for_write(uint64_t index) {
+        std::shared_ptr<page> &p = pages.at(index / page_words);
+        if (p.use_count() > 1) p = std::make_shared<page>(*p);
+        return p->data() + (index % page_words) * word_size;
+    }
 
 public:
-    RAM(size_t size = 1024, size_t word_size = 32) : word_size(word_size) {
+    RAM(size_t size = 1024, size_t word_size = 32, ram_backend backend = ram_analytic) : size(size), word_size(word_size), backend(backend) {
         // Initialize memory with 'size' words of 'word_size' bits each
-        memory = vector<vector<bit>>(size, vector<bit>(word_size, bit(0)));
+        if (backend == ram_circuit)
+            memory = vector<vector<bit>>(size, vector<bit>(word_size, bit(0)));
+        else
+            pages.assign((size + page_words - 1) / page_words, zero_page(word_size));
         addr_bits = 0;
         while ((1u << addr_bits) < size) addr_bits++;
     }
 
     vector<bit> read(const vector<bit>& address) {
-        return ram_read(memory, address);
+        GATE_SCOPE("ram");
+        if (backend == ram_circuit)
+            return ram_read(memory, address);
+        if (size == 0) return vector<bit>{};
+
+        bit::count(ram_read_cost(size, word_size, address.size()));
+
+        uint64_t leaves[bit_slicing];
+        bool uniform = ram_leaves(size, address, leaves);
+        const bit *w = word(leaves[0]);
+        vector<bit> result(w, w + word_size);
+        if (!uniform) {
+            for (size_t lane = 1; lane < bit_slicing; lane++) {
+                w = word(leaves[lane]);
+                for (size_t r = 0; r < word_size; r++)
+                    result[r].set_lane(lane, w[r].lane(lane));
+            }
+        }
+
+        ram_read_depth(size, address, result.data(), word_size);
+        return result;
     }
 
     void write(const vector<bit>& address, const vector<bit>& data) {
-        ram_write(memory, address, data);
+        GATE_SCOPE("ram");
+        if (backend == ram_circuit) {
+            ram_write(memory, address, data);
+            return;
+        }
+        if (size == 0) return;
+        assert(data.size() == word_size);
+
+        bit::count(ram_write_cost(size, word_size, address.size()));
+
+        uint64_t leaves[bit_slicing];
+        if (ram_leaves(size, address, leaves)) {
+            bit *w = word_for_write(leaves[0]);
+            std::copy(data.begin(), data.end(), w);
+            ram_write_depth(size, address, data, nullptr, w);
+            return;
+        }
+
+        for (size_t lane = 0; lane < bit_slicing; lane++) {
+            bit *w = word_for_write(leaves[lane]);
+            for (size_t r = 0; r < word_size; r++)
+                w[r].set_lane(lane, data[r].lane(lane));
+            ram_write_depth(size, address, data, nullptr, w);
+        }
+    }
+
+    // Writes only the parts of data whose enable bit is set (one enable per
+    // data.size()/enable.size() bits, e.g. byte-enables), keeping the rest
+    // of the word: a read-modify-write in a single pass over the tree
+    void write_masked(const vector<bit>& address, const vector<bit>& data, const vector<bit>& enable) {
+        GATE_SCOPE("ram");
+        if (backend == ram_circuit) {
+            ram_write_masked(memory, address, data, enable);
+            return;
+        }
+        if (size == 0) return;
+        assert(data.size() == word_size);
+
+        bit::count(ram_write_masked_cost(size, word_size, enable.size(), address.size()));
+
+        uint64_t leaves[bit_slicing];
+        if (ram_leaves(size, address, leaves)) {
+            bit *w = word_for_write(leaves[0]);
+            ram_merge_masked(w, data, enable);
+            ram_write_depth(size, address, data, &enable, w);
+            return;
+        }
+
+        for (size_t lane = 0; lane < bit_slicing; lane++) {
+            bit *w = word_for_write(leaves[lane]);
+            ram_merge_masked(w, data, enable, lane);
+            ram_write_depth(size, address, data, &enable, w);
+        }
+    }
+
+    // Sets one lane of a stored word directly, bypassing the mux tree (no gates);
+    // used to give each SIMT lane its own input data
+    void set_lane(size_t index, size_t lane, uint32_t value) {
+        if (index >= size)
+            throw std::out_of_range("RAM::set_lane: word index out of range");
+        bit *w = backend == ram_circuit ? memory[index].data() : word_for_write(index);
+        for (size_t i = 0; i < word_size; i++)
+            w[i].set_lane(lane, (value >> i) & 1);
     }
 
+    size_t get_size() { return size; }
     size_t get_word_size() { return word_size; }
     size_t get_addr_bits() { return addr_bits; }
-};
\ No newline at end of file
+};
@@ -5,37 +5,27 @@
 #include <string>
 #include <iostream>
 
+// Widest register in use: plugins build 2*32-bit products
+#define REGISTER_MAX_WIDTH 64
+
+// Fixed-capacity register: the bits live inline, so creating and copying a
+// Register never touches the heap. Only the first width() bits are in use.
 class Register
 {
 private:
-    std::vector<bit> data;
-
-    static std::vector<bit> bit_vector_from_int32(int32_t value) // should rename
+    size_t n;
+    union
     {
-        std::vector<bit> result(32);
-        // Handle both positive and negative numbers
-        for (int i = 0; i < 32; i++)
-        {
-            result[i] = bit((value >> i) & 1);
-        }
-        return result;
-    }
+        bit data[REGISTER_MAX_WIDTH];
+    };
 
+    void set_width(size_t width);
 
-    static std::vector<bit> bit_vector_from_uint64(long long value) // should rename
-    {
-        std::vector<bit> result(64);
-        // Handle both positive and negative numbers
-        for (int i = 0; i < 64; i++)
-        {
-            result[i] = bit((value >> i) & 1);
-        }
-        return result;
-    }
-
-    
 public:
     explicit Register(size_t width = 32);
+    Register(const Register &other);
+    Register &operator=(const Register &other);
+
     Register(std::vector<bit> &bits);
     Register(bigint value, size_t width);
     Register(uint32_t value, size_t width);
@@ -48,10 +38,19 @@ public:
     bit &at(size_t index);
     const bit &at(size_t index) const;
     void push_back(const bit &b);
-    const std::vector<bit> &get_data();
+    std::vector<bit> get_data() const;
     void update_data(bigint new_data);
     uint32_t get_data_uint() const;
 
+    // Word-level gates: one gate per bit, counted in a single counter update.
+    // Both operands must have the same width.
+    Register operator~() const;
+    Register operator^(const Register &b) const;
+    Register operator&(const Register &b) const;
+    Register operator|(const Register &b) const;
+    // select ? if_one : if_zero, bit by bit
+    static Register mux(const bit &select, const Register &if_zero, const Register &if_one);
+
     // Returns a resized version of the current data (does not modify any data)
     // example: 
     // Register a(16);
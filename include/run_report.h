@@ -0,0 +1,64 @@
+#pragma once
+
+#include "bit.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Machine-readable summary of a run (--report=json|csv), written to a file
+// at exit so scripts do not have to scrape the console output
+enum report_format
+{
+    report_none,
+    report_json,
+    report_csv
+};
+
+// How a run ended. Every status but run_exited is a stop forced by one of
+// the limits or hang checks of RunOptions; the values are also the exit
+// status of the emulator, next to 0 (exited) and 1 (error).
+enum run_status
+{
+    run_exited = 0,
+    run_instruction_limit = 2, // --max-instructions
+    run_gate_limit = 3,        // --max-gates
+    run_timeout = 4,           // --timeout
+    run_self_loop = 5,         // a jump or branch to itself, which never ends
+    run_pc_outside_text = 6,   // fetch from a word no image loaded
+};
+const char *run_status_name(run_status status);
+
+struct RunReport
+{
+    struct Counter
+    {
+        uint32_t id;
+        uint64_t hits;
+        uint64_t unmatched;
+        bool open; // still active at exit, counted up to it
+        bit_ops_counts gates;
+        bit_ops_counts cpu;
+    };
+
+    std::string program;
+    run_status status = run_exited;
+    int exit_code = 0;         // a0 of the exit syscall; only if run_exited
+    uint32_t pc = 0;           // byte address of the exiting ecall, or where the run was stopped
+    uint64_t instructions = 0; // retired, including the exiting ecall
+    size_t lanes = 1;
+    bit_ops_counts gates; // whole run
+    bit_ops_counts cpu;   // without memory accesses
+    std::vector<Counter> counters;
+    double seconds = 0; // host wall time of the execution, loading excluded
+
+    // One object; gate totals under every selected cost model
+    void write_json(std::ostream &out) const;
+    // A header line, unless header is false, and one row; primary model only
+    void write_csv(std::ostream &out, bool header = true) const;
+    // With append, a CSV report adds its row to the table already in path
+    // (if any); throws std::runtime_error if path cannot be written, or its
+    // header is not this report's (other counters)
+    void save(report_format format, const std::string &path, bool append = false) const;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "batch.h"
+
+#include <string>
+
+// --sweep: a design-space sweep over the cross product of the axes of a
+// spec file, one "<key> <value>..." line per axis ('#' starts a comment,
+// paths are relative to the spec file):
+//
+//   image          program images, or directories of them
+//   cost-model     cost model files; every run is reported under each,
+//                  from the same gate counts (default: --cost-model)
+//   instr-mem-size instruction memory sizes in words (RunOptions)
+//   data-mem-size  data memory sizes in words
+//   ram-accurate   true/false, as the positional argument
+//   decoder        true/false, as the positional argument
+//   ram            analytic/circuit
+//   plugin         plug-in units as for --plugin, several joined by '+',
+//                  or none for the linked-in unit (default: --plugin)
+//   plugin-idle    idle policies as for --plugin-idle (default: --plugin-idle)
+//   max-instructions, max-gates, timeout
+//                  one bound for every run
+//   results        the results table (default: the spec with .csv)
+//
+// Each run is keyed by a hash of the image and plug-in contents, its
+// parameters, the emulator binary and its build configuration, and, with
+// max-gates, the primary cost model the bound is measured in.
+// Points with the same key run once, and every finished run is appended
+// to <results without extension>.runs with its gate counts per type, so
+// a sweep that was interrupted, or that only gained cost models, picks
+// up where it stopped. Console output of a run goes to
+// <results without extension>_logs/<key>.log.
+//
+// Runs are spread over batch.jobs threads like --batch. Writes one row per
+// point to the results table and returns 0, or 1 if a run failed to run
+// (an error, not a stopped or failing program). Throws
+// std::runtime_error on errors in the spec.
+int run_sweep(const std::string &spec_path, const RunOptions &options, const BatchOptions &batch);
@@ -2,6 +2,16 @@
 
 #include "c_headers.h"
 
+#include <chrono>
+#include <map>
+
+// Thrown by ZeroLoop when the program exits or is stopped, once everything
+// due at exit is printed and written; run_full_system returns the report
+struct run_finished
+{
+    RunReport report;
+};
+
 class ZeroLoop
 {
 private:
@@ -14,12 +24,80 @@ private:
     RAM *data_memory;                           // Pointer to data memory
     std::vector<Register> csrs;
     PLUGIN plugin;
-    bigint start_count1;
-    bigint end_count1;
-    bigint start_count_only_cpu_1;
-    bigint end_count_only_cpu_1;
-    bigint total_cpu_gate_count;
-    bigint total_cpu_gate_count_plus_mem;
+    std::vector<plugin_unit> plugin_units;      // loaded units, by funct7; the others go to plugin
+    plugin_idle_cost plugin_idle;               // for instructions that are not custom-0
+    bit_ops_counts plugin_last;                 // gates of the last custom-0 instruction, none before
+    void charge_idle_plug_in_unit();
+    bit_ops_counts total_cpu_gate_count;
+    bit_ops_counts total_cpu_gate_count_plus_mem;
+
+    // Next-state latch: an executing instruction reads the architectural
+    // state above and leaves its writes here; commit() applies them in place
+    struct PendingWrites
+    {
+        bool reg_write;
+        size_t rd;
+        Register reg_value;
+        bool csr_write;
+        size_t csr_pos;
+        Register csr_value;
+        bool pc_write;
+        uint32_t pc_value;
+
+        PendingWrites() : reg_write(false), rd(0), csr_write(false), csr_pos(0), pc_write(false), pc_value(0) {}
+    } pending;
+    void set_next_pc(uint32_t new_pc);
+
+    // ACTIVATE_COUNTER/DEACTIVATE_COUNTER regions (c/include/measure.h), by
+    // counter id. Different ids may overlap; re-activating an open id nests
+    // and only the outermost region is counted. Every region adds to the
+    // totals, which print_details reports.
+    struct Counter
+    {
+        uint64_t hits = 0;      // activations
+        uint64_t open = 0;      // nesting depth
+        uint64_t unmatched = 0; // deactivations while not active
+        bit_ops_counts start;
+        bit_ops_counts start_cpu;
+        bit_ops_counts total;
+        bit_ops_counts total_cpu; // without memory accesses (total_cpu_gate_count)
+    };
+    std::map<uint32_t, Counter> counters;
+    void print_counters();
+
+    size_t simt_lanes;                       // lanes carrying their own data set (SIMT batch mode), 1 otherwise
+    std::bitset<bit_slicing> diverged_lanes; // lanes that left lane 0's branch/address path
+    uint64_t divergence_events;
+
+    netlist_region netlist_target;           // region still to be recorded, if any
+    std::string netlist_out;
+    void save_netlist(const netlist &n, const char *model);
+    void save_open_netlist();
+
+    uint64_t retired;                        // instructions committed
+    std::chrono::steady_clock::time_point started;
+    report_format report;
+    std::string report_path;
+    bool report_append;                      // to a CSV table already in report_path
+    std::string program_name;
+    // The report of the run so far, written out if set_report asked for it
+    RunReport save_report(run_status status, int exit_code);
+
+    Profiler *profiler;                      // null unless profiling
+    std::string profile_out;                 // folded stacks, if not empty
+    size_t profile_top;
+    std::string annotate_out;                // annotated disassembly, "-" for stdout
+    bit_ops_counts plugin_gate_count;        // gates taken by the plug-in unit
+    struct ProfileStart
+    {
+        uint32_t pc;
+        bit_ops_counts gates, cpu, plugin;
+    } profile_start;                         // of the instruction in flight
+    void save_profile();
+
+    // SIMT: every lane follows lane 0's control flow and addresses
+    void check_lane_divergence(const std::vector<bit> &signal, const char *what);
+    void print_simt_lanes(Register &a0);
 
 public:
     // Constructor
@@ -31,12 +109,15 @@ public:
           instruction_memory_slow(nullptr),
           data_memory(nullptr),
           csrs(4096),
-          start_count1(0),
-          end_count1(0) ,
-          start_count_only_cpu_1(0),
-          end_count_only_cpu_1(0),
-          total_cpu_gate_count(0),
-          total_cpu_gate_count_plus_mem(0){}
+          simt_lanes(1),
+          divergence_events(0),
+          netlist_target(netlist_off),
+          retired(0),
+          started(std::chrono::steady_clock::now()),
+          report(report_none),
+          report_append(false),
+          profiler(nullptr),
+          profile_top(0) {}
 
     // Deep copy constructor
     ZeroLoop(const ZeroLoop &other)
@@ -48,12 +129,30 @@ public:
           instruction_memory_slow(other.instruction_memory_slow),
           data_memory(other.data_memory),
           csrs(other.csrs),
-          start_count1(other.start_count1),
-          end_count1(other.end_count1),
-          start_count_only_cpu_1(other.start_count_only_cpu_1),
-          end_count_only_cpu_1(other.end_count_only_cpu_1),
+          plugin_units(other.plugin_units),
+          plugin_idle(other.plugin_idle),
+          plugin_last(other.plugin_last),
           total_cpu_gate_count(other.total_cpu_gate_count),
-          total_cpu_gate_count_plus_mem(other.total_cpu_gate_count_plus_mem){}
+          total_cpu_gate_count_plus_mem(other.total_cpu_gate_count_plus_mem),
+          pending(other.pending),
+          counters(other.counters),
+          simt_lanes(other.simt_lanes),
+          diverged_lanes(other.diverged_lanes),
+          divergence_events(other.divergence_events),
+          netlist_target(other.netlist_target),
+          netlist_out(other.netlist_out),
+          retired(other.retired),
+          started(other.started),
+          report(other.report),
+          report_path(other.report_path),
+          report_append(other.report_append),
+          program_name(other.program_name),
+          profiler(other.profiler),
+          profile_out(other.profile_out),
+          profile_top(other.profile_top),
+          annotate_out(other.annotate_out),
+          plugin_gate_count(other.plugin_gate_count),
+          profile_start(other.profile_start){}
 
     void copy_state_from(const ZeroLoop &other)
     {
@@ -62,12 +161,31 @@ public:
         instruction_memory_fast = other.instruction_memory_fast;
         instruction_memory_slow = other.instruction_memory_slow;
         data_memory = other.data_memory;
-        start_count1 = other.start_count1;
-        end_count1   = other.end_count1;
-        start_count_only_cpu_1 = other.start_count_only_cpu_1;
-        end_count_only_cpu_1 = other.end_count_only_cpu_1;
+        csrs = other.csrs;
+        plugin_units = other.plugin_units;
+        plugin_idle = other.plugin_idle;
+        plugin_last = other.plugin_last;
         total_cpu_gate_count = other.total_cpu_gate_count;
         total_cpu_gate_count_plus_mem = other.total_cpu_gate_count_plus_mem;
+        pending = other.pending;
+        counters = other.counters;
+        simt_lanes = other.simt_lanes;
+        diverged_lanes = other.diverged_lanes;
+        divergence_events = other.divergence_events;
+        netlist_target = other.netlist_target;
+        netlist_out = other.netlist_out;
+        retired = other.retired;
+        started = other.started;
+        report = other.report;
+        report_path = other.report_path;
+        report_append = other.report_append;
+        program_name = other.program_name;
+        profiler = other.profiler;
+        profile_out = other.profile_out;
+        profile_top = other.profile_top;
+        annotate_out = other.annotate_out;
+        plugin_gate_count = other.plugin_gate_count;
+        profile_start = other.profile_start;
     }
 
     // RegisterFile operations
@@ -78,17 +196,20 @@ public:
     void print_registers();
 
     // ALU operations
-    Register execute_alu(Register &a, Register &b, std::vector<bit> alu_op);
-    Register execute_alu_partial(Register &a, Register &b, std::vector<bit> alu_op);
+    Register execute_alu(Register &a, Register &b, const std::vector<bit> &alu_op);
+    Register execute_alu_partial(Register &a, Register &b, const std::vector<bit> &alu_op);
     void subtract(Register &result, Register a, Register b);
 
     // PLUGIN operations
+    void set_plugin_units(const std::vector<plugin_unit> &units) { plugin_units = units; }
+    void set_plugin_idle(const plugin_idle_cost &idle) { plugin_idle = idle; }
     Register execute_plug_in_unit(Register &ret, Register a, Register b,    uint32_t funct3, uint32_t funct7, uint32_t opcode);
 
     // Conditional write to units
-    void conditional_memory_write(const bit &should_write, const std::vector<bit> &addr, const std::vector<bit> &data, std::vector<bit> f3_bits);
+    void store_bytes(const std::vector<bit> &addr, const std::vector<bit> &data, uint32_t nbytes);
+    void conditional_memory_write(const bit &should_write, const std::vector<bit> &addr, const std::vector<bit> &data, const std::vector<bit> &f3_bits);
     void conditional_memory_write(const bit &should_write, const std::vector<bit> &addr, const std::vector<bit> &data, uint32_t f3_bits);
-    Register conditional_memory_read(const bit &should_read, const std::vector<bit> &addr, std::vector<bit> f3_bits);
+    Register conditional_memory_read(const bit &should_read, const std::vector<bit> &addr, const std::vector<bit> &f3_bits);
     Register conditional_memory_read(const bit &should_read, const std::vector<bit> &addr, uint32_t f3_bits);
 
 
@@ -99,6 +220,33 @@ public:
     void full_adder(bit &s, bit &c, bit a, bit b, bit cin);
     void add(Register &ret, Register a, Register b);
     uint32_t get_pc() { return pc.read_pc(); };
+    // Word address the next instruction is fetched from (no gates)
+    void set_pc(uint32_t word) { pc.update_pc_brj(word); }
+    void set_simt_lanes(size_t lanes) { simt_lanes = lanes; }
+    // Records region as a netlist the first time it runs (see netlist.h)
+    void set_netlist(netlist_region region, const std::string &out) { netlist_target = region; netlist_out = out; }
+    // Writes a RunReport of the run of program to path at exit, or with
+    // append adds its row to the CSV table there; the clock starts now
+    void set_report(report_format format, const std::string &path, bool append, const std::string &program)
+    {
+        report = format;
+        report_path = path;
+        report_append = append;
+        program_name = program;
+        started = std::chrono::steady_clock::now();
+    }
+    // Charges every instruction between profile_begin and profile_end to
+    // profiler. At exit it is saved to <out>.folded with its top rows
+    // printed, and its annotated disassembly written to annotate
+    void set_profiler(Profiler *p, const std::string &out, size_t top, const std::string &annotate)
+    {
+        profiler = p;
+        profile_out = out;
+        profile_top = top;
+        annotate_out = annotate;
+    }
+    void profile_begin();
+    void profile_end(uint32_t instruction);
 
     // Stage operations
     void execute_instruction_with_decoder(uint32_t instruction);
@@ -108,9 +256,15 @@ public:
     void connect_memories(vector<uint32_t> *instr_mem, RAM *data_mem);
     void connect_memories(RAM *instr_mem, RAM *data_mem);
     void run_program();
+    // Applies the register, CSR and PC writes of the instruction just executed
+    void commit();
 
     // syscalls
     void handle_syscall();
+    // Ends a run that did not exit by itself: prints why, writes the report,
+    // profile and totals as at exit, and throws run_finished
+    void stop(run_status status, const std::string &reason);
+    uint64_t instructions_retired() const { return retired; }
 
     // Measure gate count
     void check_for_counter(uint32_t instr, bool start_or_end);
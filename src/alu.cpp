@@ -1,5 +1,6 @@
 #include "register.h"
 #include "alu.h"
+#include "gate_scope.h"
 #include <iostream>
 #include <algorithm>
 
@@ -18,11 +19,17 @@ void ALU::full_adder(bit &s, bit &c, bit a, bit b, bit cin)
 
 Register ALU::add(Register &ret, Register a, Register b)
 {
+    GATE_SCOPE("adder");
     bit c = bit(0); // Initialize carry to 0
 
-    // Shrink the input to the size of the return register
-    Register input_a(a.get_data_uint(), ret.width());
-    Register input_b(b.get_data_uint(), ret.width());
+    // Shrink (or zero-extend) the input to the size of the return register,
+    // bit by bit so every lane keeps its own value
+    Register input_a(ret.width());
+    Register input_b(ret.width());
+    for (size_t i = 0; i < ret.width() && i < a.width(); i++)
+        input_a.at(i) = a.at(i);
+    for (size_t i = 0; i < ret.width() && i < b.width(); i++)
+        input_b.at(i) = b.at(i);
 
     for (bigint i = 0; i < ret.width(); i++)
     {
@@ -97,6 +104,7 @@ endmodule
 
 Register ALU::barrel_shifter(Register a, Register shift_amount, bool left_or_right, bool arithmetic)
 {
+    GATE_SCOPE("shifter");
     bit sign = bit(arithmetic).mux(0, a.at(a.width() - 1));
 
     Register input(a.width());
@@ -182,26 +190,23 @@ Register ALU::compare_slt(Register a, Register b, Register sub_result)
 Register ALU::compare_sltu(Register a, Register b)
 {
     Register result(a.width());
-    bool a_less = false;
-    bool found_diff = false;
+    std::bitset<bit_slicing> a_less;
+    std::bitset<bit_slicing> found_diff;
 
-    // Compare bits from MSB to LSB to find the first differing bit
+    // Compare bits from MSB to LSB; each lane is decided by its first differing bit
     for (int i = a.width() - 1; i >= 0; --i)
     {
-        bit a_bit = a.at(i);
-        bit b_bit = b.at(i);
+        std::bitset<bit_slicing> a_bit = a.at(i).value_vector();
+        std::bitset<bit_slicing> b_bit = b.at(i).value_vector();
+        std::bitset<bit_slicing> diff = (a_bit ^ b_bit) & ~found_diff;
 
-        if (a_bit.value() != b_bit.value())
-        {
-            // If a's bit is 0 and b's is 1, a < b (unsigned)
-            a_less = (a_bit.value() == 0);
-            found_diff = true;
-            break;
-        }
+        // If a's bit is 0 and b's is 1, a < b (unsigned)
+        a_less |= diff & b_bit;
+        found_diff |= diff;
     }
 
     // If all bits are equal, a is not less than b (result = 0)
-    result.at(0) = bit(found_diff ? a_less : 0);
+    result.at(0) = bit(a_less);
     return result;
 }
 // TODO make this be supported
@@ -215,8 +220,9 @@ Register ALU::compare_sltu(Register a, Register b, Register sub_result)
     return result;
 }
 
-Register ALU::execute(Register &a, Register &b, std::vector<bit> alu_op)
+Register ALU::execute(Register &a, Register &b, const std::vector<bit> &alu_op)
 {
+    GATE_SCOPE("alu");
     Register result(a.width());
 
     // Decode operation using the alu_op bits
@@ -271,36 +277,28 @@ Register ALU::execute(Register &a, Register &b, std::vector<bit> alu_op)
     slt_result = compare_slt(a, b, sub_result);
     sltu_result = compare_sltu(a, b);
 
-    for (bigint i = 0; i < a.width(); i++)
-    {
-        xor_result.at(i) = a.at(i) ^ b.at(i);
-        or_result.at(i) = a.at(i) | b.at(i);
-        and_result.at(i) = a.at(i) & b.at(i);
-    }
-
-    for (bigint i = 0; i < result.width(); i++)
-    {
-        bit temp = bit(0);
-
-        temp = is_and.mux(temp, and_result.at(i));
-        temp = is_or.mux(temp, or_result.at(i));
-        temp = is_xor.mux(temp, xor_result.at(i));
-        temp = is_add.mux(temp, add_result.at(i));
-        temp = is_sub.mux(temp, sub_result.at(i));
-        temp = is_sll.mux(temp, sll_result.at(i));
-        temp = is_srl.mux(temp, srl_result.at(i));
-        temp = is_sra.mux(temp, sra_result.at(i));
-        temp = is_sltu.mux(temp, sltu_result.at(i));
-        temp = is_slt.mux(temp, slt_result.at(i));
-
-        result.at(i) = temp;
-    }
+    xor_result = a ^ b;
+    or_result = a | b;
+    and_result = a & b;
+
+    // Result selection, one word-wide mux per operation
+    result = Register::mux(is_and, result, and_result);
+    result = Register::mux(is_or, result, or_result);
+    result = Register::mux(is_xor, result, xor_result);
+    result = Register::mux(is_add, result, add_result);
+    result = Register::mux(is_sub, result, sub_result);
+    result = Register::mux(is_sll, result, sll_result);
+    result = Register::mux(is_srl, result, srl_result);
+    result = Register::mux(is_sra, result, sra_result);
+    result = Register::mux(is_sltu, result, sltu_result);
+    result = Register::mux(is_slt, result, slt_result);
 
     return result;
 }
 
-Register ALU::execute_partial(Register &a, Register &b, std::vector<bit> alu_op)
+Register ALU::execute_partial(Register &a, Register &b, const std::vector<bit> &alu_op)
 {
+    GATE_SCOPE("alu");
     Register result(a.width());
 
     // Convert alu_op bits to booleans
@@ -359,26 +357,17 @@ Register ALU::execute_partial(Register &a, Register &b, std::vector<bit> alu_op)
     else if (is_xor)
     {
         // std::cout << "Performing XOR operation" << std::endl;
-        for (bigint i = 0; i < a.width(); i++)
-        {
-            result.at(i) = a.at(i) ^ b.at(i);
-        }
+        result = a ^ b;
     }
     else if (is_or)
     {
         // std::cout << "Performing OR operation" << std::endl;
-        for (bigint i = 0; i < a.width(); i++)
-        {
-            result.at(i) = a.at(i) | b.at(i);
-        }
+        result = a | b;
     }
     else if (is_and)
     {
         // std::cout << "Performing AND operation" << std::endl;
-        for (bigint i = 0; i < a.width(); i++)
-        {
-            result.at(i) = a.at(i) & b.at(i);
-        }
+        result = a & b;
     }
     else
     {
@@ -0,0 +1,280 @@
+#include "batch.h"
+#include "console.h"
+
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// Work-stealing job queues: every worker starts with its share of the jobs
+// and takes them from the back of its own queue; a worker whose queue ran
+// dry steals from the front of the others', so one long program does not
+// hold back the jobs queued behind it
+class job_queues
+{
+    struct queue
+    {
+        std::mutex lock;
+        std::deque<size_t> jobs;
+    };
+    std::vector<queue> queues;
+
+public:
+    job_queues(size_t workers, size_t jobs) : queues(workers)
+    {
+        for (size_t job = 0; job < jobs; job++)
+        {
+            queues[job % workers].jobs.push_back(job);
+        }
+    }
+
+    bool next(size_t worker, size_t &job)
+    {
+        for (size_t i = 0; i < queues.size(); i++)
+        {
+            queue &q = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (q.jobs.empty())
+                continue;
+            if (i == 0)
+            {
+                job = q.jobs.back();
+                q.jobs.pop_back();
+            }
+            else
+            {
+                job = q.jobs.front();
+                q.jobs.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+};
+
+struct BatchResult
+{
+    std::string name;
+    RunReport report;
+    std::string error; // the run threw
+    bool passed = false;
+};
+
+// Names of the output files: the image's file name without its extension,
+// numbered when several images share one
+std::vector<std::string> output_names(const std::vector<std::string> &images)
+{
+    std::map<std::string, size_t> uses;
+    std::vector<std::string> names;
+    for (const auto &image : images)
+    {
+        names.push_back(fs::path(image).stem().string());
+        uses[names.back()]++;
+    }
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        if (uses[names[i]] > 1)
+            names[i] += "-" + std::to_string(i);
+    }
+    return names;
+}
+
+std::string result_name(const BatchResult &result)
+{
+    if (!result.error.empty())
+        return "ERROR";
+    return result.passed ? "PASS" : "FAIL";
+}
+
+}
+
+size_t batch_workers(size_t requested, size_t jobs)
+{
+    size_t workers = requested ? requested : std::max(1u, std::thread::hardware_concurrency());
+    return std::max<size_t>(1, std::min(workers, jobs));
+}
+
+void run_jobs(size_t jobs, size_t workers, const std::function<void(size_t)> &job)
+{
+    job_queues queues(workers, jobs);
+    std::vector<std::thread> threads;
+    for (size_t id = 0; id < workers; id++)
+    {
+        threads.emplace_back([&queues, &job, id]()
+        {
+            size_t next;
+            while (queues.next(id, next))
+                job(next);
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+std::vector<std::string> read_image_list(const std::string &path)
+{
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+    std::ifstream list(path);
+    if (!list.is_open())
+    {
+        throw std::runtime_error("Could not open image list " + path);
+    }
+
+    std::vector<std::string> images;
+    std::string line;
+    while (std::getline(list, line))
+    {
+        line = line.substr(0, line.find('#'));
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos)
+            continue;
+        size_t end = line.find_last_not_of(" \t\r");
+        std::string image = line.substr(start, end - start + 1);
+        images.push_back(image[0] == '/' ? image : dir + image);
+    }
+    if (images.empty())
+    {
+        throw std::runtime_error("Image list " + path + " is empty");
+    }
+    return images;
+}
+
+std::vector<std::string> batch_images(const std::string &list_or_dir)
+{
+    if (!fs::is_directory(list_or_dir))
+        return read_image_list(list_or_dir);
+
+    std::vector<std::string> images;
+    for (const auto &entry : fs::directory_iterator(list_or_dir))
+    {
+        std::string extension = entry.path().extension().string();
+        if (entry.is_regular_file() && (extension == ".elf" || extension == ".vmh" || extension == ".img"))
+            images.push_back(entry.path().string());
+    }
+    if (images.empty())
+    {
+        throw std::runtime_error("No program images (*.elf, *.vmh, *.img) in " + list_or_dir);
+    }
+    std::sort(images.begin(), images.end());
+    return images;
+}
+
+int run_batch(const std::vector<std::string> &images, bool ram_accurate, bool with_decoder,
+              const RunOptions &options, const BatchOptions &batch)
+{
+    if (options.verify_ram_cost)
+    {
+        ram_cost_verify(std::cout);
+    }
+    fs::create_directories(batch.out_dir);
+
+    size_t workers = batch_workers(batch.jobs, images.size());
+    std::cout << "Running " << images.size() << " programs on " << workers << " threads, output in "
+              << batch.out_dir << "/" << std::endl;
+
+    std::vector<std::string> names = output_names(images);
+    std::vector<BatchResult> results(images.size());
+    std::mutex print_lock;
+    size_t finished = 0;
+    sim_context all; // the gates of every program
+
+    run_jobs(images.size(), workers, [&](size_t job)
+    {
+        BatchResult &result = results[job];
+        result.name = names[job];
+        std::string base = batch.out_dir + "/" + names[job];
+
+        RunOptions run = options;
+        run.verify_ram_cost = false;
+        run.report = options.report == report_none ? report_json : options.report;
+        run.report_out = base + (run.report == report_json ? ".json" : ".csv");
+        if (!run.profile_out.empty())
+            run.profile_out = base;
+        if (!run.annotate_out.empty() && run.annotate_out != "-")
+            run.annotate_out = base + ".annotated";
+        run.netlist_out = base;
+
+        // the run counts its gates in a context of its own
+        sim_context context;
+        sim_context::scope counting(context);
+        std::ofstream log(base + ".log");
+        set_console(&log);
+        try
+        {
+            result.report = run_full_system(images[job].c_str(), ram_accurate, with_decoder, run);
+            result.passed = result.report.status == run_exited && result.report.exit_code == 0;
+        }
+        catch (const std::exception &e)
+        {
+            result.error = e.what();
+            log << "Error: " << e.what() << "\n";
+        }
+        set_console(nullptr);
+
+        std::lock_guard<std::mutex> guard(print_lock);
+        all.merge(context);
+        finished++;
+        std::cout << "[" << finished << "/" << images.size() << "] " << result_name(result) << " " << images[job];
+        if (!result.error.empty())
+            std::cout << ": " << result.error;
+        else if (result.report.status != run_exited)
+            std::cout << " (" << run_status_name(result.report.status) << ")";
+        else if (!result.passed)
+            std::cout << " (exit code " << result.report.exit_code << ")";
+        std::cout << std::endl;
+    });
+
+    const bit_cost_model &primary = bit_cost_model::primary();
+    std::ofstream csv(batch.out_dir + "/summary.csv");
+    csv << "program,result,status,exit_code,instructions,gates,cpu_gates,wall_seconds\n";
+
+    std::cout << "\nBatch summary:\n";
+    std::cout << "-----------------------------\n";
+    std::cout << std::setw(28) << std::left << "program"
+              << std::setw(8) << std::left << "result"
+              << std::setw(20) << std::left << "status"
+              << std::setw(12) << std::left << "exit code"
+              << std::setw(16) << std::left << "instructions"
+              << std::setw(18) << std::left << "gates"
+              << "seconds\n";
+
+    size_t passed = 0;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BatchResult &result = results[i];
+        const RunReport &r = result.report;
+        passed += result.passed;
+        std::string status = result.error.empty() ? run_status_name(r.status) : "error";
+        std::string exit_code = result.error.empty() && r.status == run_exited ? std::to_string(r.exit_code) : "";
+
+        std::cout << std::setw(28) << std::left << result.name
+                  << std::setw(8) << std::left << result_name(result)
+                  << std::setw(20) << std::left << status
+                  << std::setw(12) << std::left << exit_code
+                  << std::setw(16) << std::left << r.instructions
+                  << std::setw(18) << std::left << primary.cost(r.gates)
+                  << std::fixed << std::setprecision(3) << r.seconds << std::defaultfloat << "\n";
+        csv << images[i] << "," << result_name(result) << "," << status << "," << exit_code << ","
+            << r.instructions << "," << primary.cost(r.gates) << "," << primary.cost(r.cpu) << ","
+            << std::fixed << std::setprecision(6) << r.seconds << std::defaultfloat << "\n";
+    }
+    std::cout << "\n" << passed << " of " << results.size() << " programs passed, "
+              << primary.cost(all.counts()) << " gates in all" << std::endl;
+    std::cout << "Wrote " << batch.out_dir << "/summary.csv" << std::endl;
+
+    return passed == results.size() ? 0 : 1;
+}
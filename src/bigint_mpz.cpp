@@ -368,7 +368,7 @@ ostream &operator<<(ostream &o,const bigint &a)
   return o << a.get_str();
 }
 
-static map<pair<bigint,bigint>,bigint> binomial_cache;
+static thread_local map<pair<bigint,bigint>,bigint> binomial_cache;
 
 bigint binomial(bigint n,bigint k)
 {
@@ -1,14 +1,37 @@
 #include "bit.h"
+#include "bit_cost_model.h"
 
-bigint bit::cost = 0;
-bigint bit::numnot = 0;
-bigint bit::numxor = 0;
-bigint bit::numand = 0;
-bigint bit::numor = 0;
-bigint bit::numxnor = 0;
-bigint bit::numandn = 0;
-bigint bit::numnand = 0;
-bigint bit::numorn = 0;
-bigint bit::numnor = 0;
-bigint bit::nummux = 0;
-bigint bit::numcswap = 0;
+thread_local sim_context *sim_context::active = nullptr;
+
+sim_context &sim_context::thread_default(void)
+{
+  static thread_local sim_context own;
+  active = &own;
+  return own;
+}
+
+// one level per gate until a cost model sets its delays
+uint64_t bit_depth::delay[bit_ops_count] = { 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+#if ZEROLOOP_DEPTH
+thread_local uint64_t bit_depth::now = 0;
+thread_local uint64_t bit_depth::cycle_stamp = 0;
+thread_local uint64_t bit_depth::local_stamp = 0;
+thread_local uint64_t bit_depth::cycle_max = 0;
+thread_local uint64_t bit_depth::local_max = 0;
+#endif
+
+bigint bit_gates::ops(void)
+{
+  return bit_cost_model::primary().cost();
+}
+
+void bit_counter::spill(void)
+{
+  ++wraps;
+}
+
+bigint bit_counter::value(void) const
+{
+  return (wraps << 64) + bigint(lo);
+}
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "bit_cost.h"
+#include "bit_cost_model.h"
+
+using namespace std;
+
+static vector<bit_cost_model> selected_models;
+
+bit_cost_model::bit_cost_model() : name("default")
+{
+  weight[bit_ops_cost] = 0;
+  weight[bit_ops_not] = bit_not_cost;
+  weight[bit_ops_xor] = bit_xor_cost;
+  weight[bit_ops_and] = bit_and_cost;
+  weight[bit_ops_or] = bit_or_cost;
+  weight[bit_ops_xnor] = bit_xnor_cost;
+  weight[bit_ops_andn] = bit_andn_cost;
+  weight[bit_ops_nand] = bit_nand_cost;
+  weight[bit_ops_orn] = bit_orn_cost;
+  weight[bit_ops_nor] = bit_nor_cost;
+  weight[bit_ops_mux] = bit_mux_cost;
+  weight[bit_ops_cswap] = bit_cswap_cost;
+
+  // one level of logic per gate unless the model says otherwise
+  delay[bit_ops_cost] = 0;
+  for (const auto &t : bit_ops_selectors)
+    if (t != bit_ops_cost) delay[t] = 1;
+}
+
+bit_cost_model bit_cost_model::from_file(const string &path)
+{
+  ifstream file(path);
+  if (!file.is_open())
+    throw runtime_error("Could not open cost model " + path);
+
+  bit_cost_model m;
+  m.name = path;
+  size_t slash = m.name.find_last_of('/');
+  if (slash != string::npos) m.name = m.name.substr(slash + 1);
+  size_t dot = m.name.find_last_of('.');
+  if (dot != string::npos && dot > 0) m.name = m.name.substr(0, dot);
+
+  string line;
+  size_t lineno = 0;
+  while (getline(file, line)) {
+    ++lineno;
+    size_t hash = line.find('#');
+    if (hash != string::npos) line = line.substr(0, hash);
+
+    istringstream in(line);
+    string key, value;
+    if (!(in >> key)) continue;
+    if (!(in >> value))
+      throw runtime_error(path + ":" + to_string(lineno) + ": missing value for " + key);
+
+    if (key == "name") {
+      m.name = value;
+      continue;
+    }
+
+    // "delay <gate> <delay>" sets the logic delay instead of the weight
+    uint64_t *target = m.weight;
+    if (key == "delay") {
+      key = value;
+      if (!(in >> value))
+        throw runtime_error(path + ":" + to_string(lineno) + ": missing delay for " + key);
+      target = m.delay;
+    }
+
+    bool found = false;
+    for (const auto &t : bit_ops_selectors) {
+      if (t == bit_ops_cost || key != bit::opsname(t)) continue;
+      size_t end = 0;
+      unsigned long long w = 0;
+      try { w = stoull(value, &end); } catch (const exception &) { end = 0; }
+      if (end != value.size())
+        throw runtime_error(path + ":" + to_string(lineno) + ": bad weight " + value);
+      target[t] = w;
+      found = true;
+    }
+    if (!found)
+      throw runtime_error(path + ":" + to_string(lineno) + ": unknown gate " + key);
+  }
+
+  return m;
+}
+
+bigint bit_cost_model::cost(const bit_ops_counts &counts) const
+{
+  bigint result = 0;
+  for (const auto &t : bit_ops_selectors)
+    if (t != bit_ops_cost && weight[t] && counts[t])
+      result += bigint(weight[t]) * bigint(counts[t]);
+  return result;
+}
+
+bigint bit_cost_model::cost(void) const
+{
+  bigint result = 0;
+  for (const auto &t : bit_ops_selectors)
+    if (t != bit_ops_cost && weight[t])
+      result += bigint(weight[t]) * bit::ops(t);
+  return result;
+}
+
+void bit_cost_model::select(const bit_cost_model &m)
+{
+  selected_models.push_back(m);
+  // gate depths are measured with the delays of the primary model
+  if (selected_models.size() == 1)
+    copy(m.delay, m.delay + bit_ops_count, bit_depth::delay);
+}
+
+const vector<bit_cost_model> &bit_cost_model::selected(void)
+{
+  return selected_models;
+}
+
+const bit_cost_model &bit_cost_model::primary(void)
+{
+  static const bit_cost_model defaults;
+  if (selected_models.empty()) return defaults;
+  return selected_models.front();
+}
@@ -0,0 +1,13 @@
+#include "console.h"
+
+static thread_local std::ostream *console_stream = nullptr;
+
+std::ostream &console()
+{
+    return console_stream ? *console_stream : std::cout;
+}
+
+void set_console(std::ostream *out)
+{
+    console_stream = out;
+}
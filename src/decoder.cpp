@@ -1,4 +1,5 @@
 #include "decoder.h"
+#include "gate_scope.h"
 
 uint32_t Decoder::get_opcode(uint32_t instruction)
 {
@@ -300,3 +301,25 @@ Decoder::DecodedInstruction Decoder::decode(uint32_t instruction)
 
     return decoded;
 }
+
+const Decoder::DecodedInstruction &Decoder::decode_cached(uint32_t pc, uint32_t instruction)
+{
+    GATE_SCOPE("decode");
+    auto it = decode_cache.find(pc);
+    // A recorded netlist needs the decoder's gates, not a replay of their
+    // counts, and DEPTH builds need its outputs stamped in this cycle so the
+    // logic they feed sees the decode path
+    if (it != decode_cache.end() && it->second.instruction == instruction && !netlist_recording() && !ZEROLOOP_DEPTH)
+    {
+        bit::count(it->second.gates);
+        return it->second.decoded;
+    }
+
+    bit_ops_counts start = bit::counts();
+    DecodedInstruction decoded = decode(instruction);
+    CachedDecode &entry = decode_cache[pc];
+    entry.instruction = instruction;
+    entry.decoded = decoded;
+    entry.gates = bit::counts() - start;
+    return entry.decoded;
+}
@@ -0,0 +1,179 @@
+#include "disassembler.h"
+
+#include <sstream>
+
+static const char *const REGISTER_NAMES[32] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+    "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+    "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"};
+
+static int32_t imm_i(uint32_t instr)
+{
+    return (int32_t)instr >> 20;
+}
+
+static int32_t imm_s(uint32_t instr)
+{
+    return ((int32_t)(instr & 0xFE000000) >> 20) | ((instr >> 7) & 0x1F);
+}
+
+static int32_t imm_b(uint32_t instr)
+{
+    return ((int32_t)(instr & 0x80000000) >> 19) | ((instr << 4) & 0x800) | ((instr >> 20) & 0x7E0) |
+           ((instr >> 7) & 0x1E);
+}
+
+static int32_t imm_j(uint32_t instr)
+{
+    return ((int32_t)(instr & 0x80000000) >> 11) | (instr & 0xFF000) | ((instr >> 9) & 0x800) |
+           ((instr >> 20) & 0x7FE);
+}
+
+std::string disassemble(uint32_t instruction, uint32_t pc)
+{
+    uint32_t opcode = instruction & 0x7F;
+    uint32_t funct3 = (instruction >> 12) & 0x7;
+    uint32_t funct7 = instruction >> 25;
+    const char *rd = REGISTER_NAMES[(instruction >> 7) & 0x1F];
+    const char *rs1 = REGISTER_NAMES[(instruction >> 15) & 0x1F];
+    const char *rs2 = REGISTER_NAMES[(instruction >> 20) & 0x1F];
+    bool rd_zero = ((instruction >> 7) & 0x1F) == 0;
+    bool rs1_zero = ((instruction >> 15) & 0x1F) == 0;
+
+    std::ostringstream s;
+    switch (opcode)
+    {
+    case 0x37: // LUI
+    case 0x17: // AUIPC
+        s << (opcode == 0x37 ? "lui " : "auipc ") << rd << ", 0x" << std::hex << (instruction >> 12);
+        break;
+
+    case 0x6F: // JAL
+    {
+        uint32_t target = pc + imm_j(instruction);
+        if (rd_zero)
+            s << "j 0x" << std::hex << target;
+        else
+            s << "jal " << rd << ", 0x" << std::hex << target;
+        break;
+    }
+
+    case 0x67: // JALR
+        if (funct3 != 0)
+            goto unknown;
+        if (rd_zero && imm_i(instruction) == 0)
+            s << (((instruction >> 15) & 0x1F) == 1 ? "ret" : std::string("jr ") + rs1);
+        else
+            s << "jalr " << rd << ", " << imm_i(instruction) << "(" << rs1 << ")";
+        break;
+
+    case 0x63: // BRANCH
+    {
+        static const char *const names[8] = {"beq", "bne", nullptr, nullptr, "blt", "bge", "bltu", "bgeu"};
+        if (!names[funct3])
+            goto unknown;
+        s << names[funct3] << " " << rs1 << ", " << rs2 << ", 0x" << std::hex << pc + imm_b(instruction);
+        break;
+    }
+
+    case 0x03: // LOAD
+    {
+        static const char *const names[8] = {"lb", "lh", "lw", nullptr, "lbu", "lhu", nullptr, nullptr};
+        if (!names[funct3])
+            goto unknown;
+        s << names[funct3] << " " << rd << ", " << imm_i(instruction) << "(" << rs1 << ")";
+        break;
+    }
+
+    case 0x23: // STORE
+    {
+        static const char *const names[8] = {"sb", "sh", "sw", nullptr, nullptr, nullptr, nullptr, nullptr};
+        if (!names[funct3])
+            goto unknown;
+        s << names[funct3] << " " << rs2 << ", " << imm_s(instruction) << "(" << rs1 << ")";
+        break;
+    }
+
+    case 0x13: // OP-IMM
+    {
+        static const char *const names[8] = {"addi", "slli", "slti", "sltiu", "xori", "srli", "ori", "andi"};
+        int32_t imm = imm_i(instruction);
+        if (funct3 == 1 || funct3 == 5)
+        {
+            if (funct7 != 0 && !(funct3 == 5 && funct7 == 0x20))
+                goto unknown;
+            s << (funct3 == 1 ? "slli " : funct7 ? "srai " : "srli ") << rd << ", " << rs1 << ", "
+              << ((instruction >> 20) & 0x1F);
+        }
+        else if (funct3 == 0 && rd_zero && rs1_zero && imm == 0)
+            s << "nop";
+        else if (funct3 == 0 && rs1_zero)
+            s << "li " << rd << ", " << imm;
+        else if (funct3 == 0 && imm == 0)
+            s << "mv " << rd << ", " << rs1;
+        else
+            s << names[funct3] << " " << rd << ", " << rs1 << ", " << imm;
+        break;
+    }
+
+    case 0x33: // OP
+    {
+        static const char *const names[8] = {"add", "sll", "slt", "sltu", "xor", "srl", "or", "and"};
+        if (funct7 == 0)
+            s << names[funct3];
+        else if (funct7 == 0x20 && funct3 == 0)
+            s << "sub";
+        else if (funct7 == 0x20 && funct3 == 5)
+            s << "sra";
+        else
+            goto unknown;
+        s << " " << rd << ", " << rs1 << ", " << rs2;
+        break;
+    }
+
+    case 0x0F: // MISC-MEM
+        s << (funct3 == 1 ? "fence.i" : "fence");
+        break;
+
+    case 0x73: // SYSTEM
+    {
+        static const char *const names[8] = {nullptr, "csrrw", "csrrs", "csrrc", nullptr, "csrrwi", "csrrsi", "csrrci"};
+        if (instruction == 0x00000073)
+            s << "ecall";
+        else if (instruction == 0x00100073)
+            s << "ebreak";
+        else if (names[funct3])
+        {
+            s << names[funct3] << " " << rd << ", 0x" << std::hex << (instruction >> 20) << std::dec << ", ";
+            if (funct3 & 4)
+                s << ((instruction >> 15) & 0x1F);
+            else
+                s << rs1;
+        }
+        else
+            goto unknown;
+        break;
+    }
+
+    case 0x0B: // CUSTOM0, the plug-in unit
+        s << ".insn r 0x0b, " << funct3 << ", " << funct7 << ", " << rd << ", " << rs1 << ", " << rs2;
+        break;
+
+    case 0x2B: // CUSTOM1, counters
+        if (funct3 == 0)
+            s << "activate_counter " << (instruction >> 20);
+        else if (funct3 == 1)
+            s << "deactivate_counter " << (instruction >> 20);
+        else
+            s << ".insn i 0x2b, " << funct3 << ", " << rd << ", " << rs1 << ", " << imm_i(instruction);
+        break;
+
+    default:
+    unknown:
+        s.str("");
+        s << ".word 0x" << std::hex << instruction;
+        break;
+    }
+    return s.str();
+}
@@ -1,4 +1,5 @@
 #include "full_sys.h"
+#include "gate_scope.h"
 
 bigint total_cost = 0;
 
@@ -15,265 +16,358 @@ int32_t register_to_int(Register &reg)
     return result;
 }
 
-void load_instructions(RAM *instr_mem, RAM *data_mem, const char *file_location, uint32_t data_start_addr)
+static std::vector<bit> to_bitvector(uint32_t value, size_t bits)
 {
-    std::ifstream vmh_file(file_location);
-    if (!vmh_file.is_open())
+    std::vector<bit> result;
+    for (size_t i = 0; i < bits; i++)
     {
-        throw std::runtime_error("Could not open VMH file");
+        result.push_back(bit((value >> i) & 1));
     }
+    return result;
+}
 
-    std::string line;
-    uint32_t current_addr = 0;
-    bool is_data_section = false;
+// Index of a data word in data memory, which starts at DATA_MEM_BASE
+static uint32_t data_index(const char *file_location, uint32_t addr, size_t size)
+{
+    uint32_t index = (addr - DATA_MEM_BASE) >> 2;
+    if (index >= size)
+    {
+        throw std::runtime_error(std::string(file_location) + ": data outside of data memory");
+    }
+    return index;
+}
 
-    auto hex_to_uint32 = [](const std::string &hex_str) -> uint32_t
+// Index of a text word in instruction memory, which starts at 0
+static uint32_t instr_index(const char *file_location, uint32_t addr, size_t size)
+{
+    uint32_t index = addr >> 2;
+    if (index >= size)
     {
-        uint32_t value;
-        std::stringstream ss;
-        ss << std::hex << hex_str;
-        ss >> value;
-        return value;
-    };
-
-    auto to_bitvector = [](uint32_t value, size_t bits) -> std::vector<bit>
+        throw std::runtime_error(std::string(file_location) + ": text outside of instruction memory");
+    }
+    return index;
+}
+
+static void log_word(int verbose, const char *what, uint32_t addr, uint32_t value)
+{
+    if (verbose >= 2)
     {
-        std::vector<bit> result;
-        for (size_t i = 0; i < bits; i++)
-        {
-            result.push_back(bit((value >> i) & 1));
-        }
-        return result;
-    };
+        console() << "Loaded " << what << " at 0x" << std::hex << addr << ": 0x" << value << std::dec << "\n";
+    }
+}
 
-    while (std::getline(vmh_file, line))
+static void log_image(int verbose, const char *file_location, const ProgramImage &image, size_t text_words, size_t data_words)
+{
+    if (verbose >= 1)
     {
-        if (line.empty())
-            continue;
+        uint64_t zero_bytes = 0;
+        for (const auto &range : image.zero)
+            zero_bytes += range.second;
+        console() << "Loaded " << text_words << " instruction words and " << data_words
+                  << " data words from " << file_location << " (" << zero_bytes << " bytes zero-filled, "
+                  << image.symbols.size() << " symbols, entry 0x" << std::hex << image.entry << std::dec << ")" << std::endl;
+    }
+}
 
-        if (line[0] == '@')
+ProgramImage load_instructions(RAM *instr_mem, RAM *data_mem, const char *file_location, int verbose)
+{
+    ProgramImage image = read_program_image(file_location);
+    size_t text_words = 0, data_words = 0;
+    for (const auto &word : image.words)
+    {
+        std::vector<bit> value_bits = to_bitvector(word.second, 32);
+        if (word.first >= DATA_MEM_BASE)
         {
-            std::string addr_str = line.substr(1);
-            current_addr = hex_to_uint32(addr_str);
-            std::cout<<"Current Address"<<current_addr<<std::endl;
-            std::cout<<"Data Sart Address"<<data_start_addr<<std::endl;
-
-            if (current_addr >= data_start_addr)
-            {
-                is_data_section = true;
-                std::cout<<"IS DATA SECTION: ON"<<std::endl;
-            }
+            std::vector<bit> addr_bits = to_bitvector(data_index(file_location, word.first, data_mem->get_size()), data_mem->get_addr_bits());
+            data_mem->write(addr_bits, value_bits);
+            log_word(verbose, "DATA", word.first, word.second);
+            data_words++;
         }
         else
         {
-            uint32_t value = hex_to_uint32(line);
-
-            uint32_t word_addr = current_addr >> 2;
-
-            std::vector<bit> value_bits = to_bitvector(value, 32);
-
-            if (is_data_section)
-            {
-                uint32_t relative_addr = (current_addr - data_start_addr) >> 2;
-                std::vector<bit> addr_bits = to_bitvector(relative_addr, data_mem->get_addr_bits());
-                data_mem->write(addr_bits, value_bits);
-                std::cout << "Loaded DATA at 0x" << std::hex << current_addr
-                        << ": 0x" << value 
-                        << " at memory index " << std::dec << relative_addr << std::endl;
-            }
-            else
-            {
-                std::vector<bit> addr_bits = to_bitvector(word_addr, instr_mem->get_addr_bits());
-                instr_mem->write(addr_bits, value_bits);
-                std::cout << "Loaded INSTRUCTION at 0x" << std::hex << current_addr
-                          << ": 0x" << value
-                          << std::dec << std::endl;
-            }
-
-            current_addr += 4;
+            std::vector<bit> addr_bits = to_bitvector(instr_index(file_location, word.first, instr_mem->get_size()), instr_mem->get_addr_bits());
+            instr_mem->write(addr_bits, value_bits);
+            log_word(verbose, "INSTRUCTION", word.first, word.second);
+            text_words++;
         }
     }
-
-    vmh_file.close();
+    log_image(verbose, file_location, image, text_words, data_words);
+    return image;
 }
 
-void load_instructions(std::vector<uint32_t> &instr_mem, RAM *data_mem, const char *file_location, uint32_t data_start_addr)
+ProgramImage load_instructions(std::vector<uint32_t> &instr_mem, RAM *data_mem, const char *file_location, int verbose)
 {
-    std::ifstream vmh_file(file_location);
-    if (!vmh_file.is_open())
-    {
-        throw std::runtime_error("Could not open VMH file");
-    }
-
-    auto hex_to_uint32 = [](const std::string &hex_str) -> uint32_t
+    ProgramImage image = read_program_image(file_location);
+    size_t text_words = 0, data_words = 0;
+    for (const auto &word : image.words)
     {
-        uint32_t value;
-        std::stringstream ss;
-        ss << std::hex << hex_str;
-        ss >> value;
-        return value;
-    };
-
-    auto to_bitvector = [](uint32_t value, size_t bits) -> std::vector<bit>
-    {
-        std::vector<bit> result;
-        for (size_t i = 0; i < bits; i++)
+        if (word.first >= DATA_MEM_BASE)
         {
-            result.push_back(bit((value >> i) & 1));
+            std::vector<bit> addr_bits = to_bitvector(data_index(file_location, word.first, data_mem->get_size()), data_mem->get_addr_bits());
+            data_mem->write(addr_bits, to_bitvector(word.second, 32));
+            log_word(verbose, "DATA", word.first, word.second);
+            data_words++;
         }
-        return result;
-    };
+        else
+        {
+            instr_mem[instr_index(file_location, word.first, instr_mem.size())] = word.second;
+            log_word(verbose, "INSTRUCTION", word.first, word.second);
+            text_words++;
+        }
+    }
+    log_image(verbose, file_location, image, text_words, data_words);
+    return image;
+}
 
-    std::string line;
-    uint32_t current_addr = 0;
-    bool is_data_section = false;
+void load_simt_lanes(RAM *data_mem, const char *program_location, const std::vector<std::string> &lane_images, int verbose)
+{
+    if (lane_images.size() > bit_slicing)
+    {
+        throw std::runtime_error("SIMT batch supports at most " + std::to_string(bit_slicing) + " lanes");
+    }
 
-    while (std::getline(vmh_file, line))
+    // Lanes share one instruction stream, so every image must carry the same text
+    std::vector<std::pair<uint32_t, uint32_t>> text;
+    for (const auto &word : read_program_image(program_location).words)
     {
-        if (line.empty())
-            continue;
+        if (word.first < DATA_MEM_BASE)
+            text.push_back(word);
+    }
 
-        if (line[0] == '@')
+    for (size_t lane = 0; lane < lane_images.size(); lane++)
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> lane_text;
+        for (const auto &word : read_program_image(lane_images[lane].c_str()).words)
         {
-            std::string addr_str = line.substr(1);
-            current_addr = hex_to_uint32(addr_str);
-            std::cout<<"Current Address: "<<std::hex<<current_addr<<std::endl;
-            std::cout<<"Data Sart Address: "<<std::hex<<(data_start_addr >> 2)<<std::endl;
-
-            if (current_addr >= data_start_addr)
+            if (word.first < DATA_MEM_BASE)
             {
-                is_data_section = true;
-                std::cout<<"IS DATA SECTION: ON"<<std::endl;
+                lane_text.push_back(word);
+                continue;
             }
-        }
-        else
-        {
-            uint32_t value = hex_to_uint32(line);
-
-            uint32_t word_addr = current_addr >> 2;
 
-            std::vector<bit> value_bits = to_bitvector(value, 32);
-
-            if (is_data_section)
-            {
-                std::vector<bit> addr_bits = to_bitvector((current_addr - data_start_addr) >> 2, data_mem->get_addr_bits());
-                data_mem->write(addr_bits, value_bits);
-                std::cout << "Loaded DATA at 0x" << std::hex << (current_addr)
-                          << ": 0x" << value
-                          << std::dec << std::endl;
-            }
-            else
+            uint32_t index = (word.first - DATA_MEM_BASE) >> 2;
+            if (index >= data_mem->get_size())
             {
-                instr_mem.at(word_addr) = value;
-                std::cout << "Loaded INSTRUCTION at 0x" << std::hex << current_addr
-                          << ": 0x" << value
-                          << std::dec << std::endl;
+                throw std::runtime_error(lane_images[lane] + ": data outside of data memory");
             }
+            data_mem->set_lane(index, lane, word.second);
+        }
 
-            current_addr += 4;
+        if (lane_text != text)
+        {
+            throw std::runtime_error(lane_images[lane] + ": text differs from " + program_location);
+        }
+        if (verbose >= 1)
+        {
+            console() << "Loaded SIMT lane " << lane << " from " << lane_images[lane] << std::endl;
         }
     }
+}
+
+static std::string hex_address(uint32_t address)
+{
+    std::ostringstream s;
+    s << "0x" << std::hex << address;
+    return s.str();
+}
 
-    vmh_file.close();
+// kind of instruction, for reporting per-cycle logic depth
+static const char *instruction_class(uint32_t instruction)
+{
+    switch (instruction & 0x7F)
+    {
+    case 0x03: return "load";
+    case 0x0B: return "custom";
+    case 0x13: return "op-imm";
+    case 0x17: return "auipc";
+    case 0x23: return "store";
+    case 0x2B: return "counter";
+    case 0x33: return "op";
+    case 0x37: return "lui";
+    case 0x63: return "branch";
+    case 0x67: return "jalr";
+    case 0x6F: return "jal";
+    case 0x73: return "system";
+    default: return "other";
+    }
 }
 
-void run_full_system(char *instr_location, bool ram_accurate, bool with_decoder)
+RunReport run_full_system(const char *instr_location, bool ram_accurate, bool with_decoder, const RunOptions &options)
 {
+    if (options.verify_ram_cost)
+    {
+        ram_cost_verify(console());
+    }
+    if (options.netlist != netlist_off && !ZEROLOOP_NETLIST)
+    {
+        throw std::runtime_error("--netlist needs a build with make NETLIST=1");
+    }
+    // Data memory starts at DATA_MEM_BASE, the end of the largest instruction memory
+    if (options.instr_mem_words == 0 || options.instr_mem_words > INSTR_MEM_SIZE)
+    {
+        throw std::runtime_error("Instruction memory must be 1 to " + std::to_string(INSTR_MEM_SIZE) + " words");
+    }
+    if (options.data_mem_words == 0)
+    {
+        throw std::runtime_error("Data memory must have at least one word");
+    }
+    std::vector<plugin_unit> plugin_units = load_plugin_units(options.plugins);
+
     bit::clear_all();
-    std::cout << "\n=== Testing RISC-V CPU Implementation ===\n";
+    gate_scope_clear();
+    console() << "\n=== Testing RISC-V CPU Implementation ===\n";
 
-    std::vector<uint32_t> instruction_memory_fast(INSTR_MEM_SIZE);
-    RAM instruction_memory_slow(INSTR_MEM_SIZE, 32);
-    RAM data_memory(DATA_MEM_SIZE, 32);
+    // Only the instruction memory of the selected mode is backed by host memory
+    std::vector<uint32_t> instruction_memory_fast(ram_accurate ? 0 : options.instr_mem_words);
+    RAM instruction_memory_slow(ram_accurate ? options.instr_mem_words : 0, 32, options.ram);
+    RAM data_memory(options.data_mem_words, 32, options.ram);
 
+    ProgramImage image;
     if (ram_accurate)
     {
-        load_instructions(&instruction_memory_slow, &data_memory, instr_location, (INSTR_MEM_SIZE));// Since they are vmh, it will start at INSTR_MEM_SIZE/4
+        image = load_instructions(&instruction_memory_slow, &data_memory, instr_location, options.verbose);
     }
     else
     {
-        load_instructions(instruction_memory_fast, &data_memory, instr_location, (INSTR_MEM_SIZE/4));
+        image = load_instructions(instruction_memory_fast, &data_memory, instr_location, options.verbose);
     }
 
-    std::cout << "\nStarting program execution:\n";
-    std::cout << "===========================\n";
+    if (!options.simt_images.empty())
+    {
+        load_simt_lanes(&data_memory, instr_location, options.simt_images, options.verbose);
+    }
 
-    ZeroLoop *currentCPU = new ZeroLoop();
+    // Words some image loaded into instruction memory; fetching any other
+    // word means the program ran off its code
+    std::vector<bool> text(options.instr_mem_words);
+    for (const auto &word : image.words)
+    {
+        if (word.first < DATA_MEM_BASE)
+            text[word.first >> 2] = true;
+    }
+
+    console() << "\nStarting program execution:\n";
+    console() << "===========================\n";
+
+    // One CPU for the whole run: each step executes against the current
+    // state and then commits its latched writes in place
+    ZeroLoop cpu;
+    cpu.set_simt_lanes(std::max<size_t>(options.simt_images.size(), 1));
+    cpu.set_plugin_units(plugin_units);
+    cpu.set_plugin_idle(options.plugin_idle);
+    cpu.set_pc(image.entry >> 2);
+    cpu.set_netlist(options.netlist, options.netlist_out);
+    cpu.set_report(options.report, options.report_out, options.report_append, instr_location);
+
+    std::unique_ptr<Profiler> profiler;
+    if (!options.profile_out.empty() || !options.annotate_out.empty())
+    {
+        profiler.reset(new Profiler(image));
+        cpu.set_profiler(profiler.get(), options.profile_out, options.profile_top, options.annotate_out);
+    }
 
     if (ram_accurate)
     {
-        currentCPU->connect_memories(&instruction_memory_slow, &data_memory);
+        cpu.connect_memories(&instruction_memory_slow, &data_memory);
     }
     else
     {
-        currentCPU->connect_memories(&instruction_memory_fast, &data_memory);
+        cpu.connect_memories(&instruction_memory_fast, &data_memory);
     }
 
     //bit::clear_all();
 
-    while (true)
+    const bigint max_gates((unsigned long long)options.max_gates);
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.timeout));
+
+    try
     {
-        // Check how many operations a single instruction takes
-        // end_count - start_count = current instruction count
-        bigint current_start_instr_gate_count = bit::ops();
-        
-        uint32_t current_pc = currentCPU->get_pc();
+        while (true)
+        {
+            uint32_t current_pc = cpu.get_pc();
+            if (current_pc >= text.size() || !text[current_pc])
+            {
+                cpu.stop(run_pc_outside_text, "fetch from " + hex_address(current_pc * 4) + ", outside the loaded text");
+            }
 
-        ZeroLoop *nextCPU = new ZeroLoop();
-        nextCPU->copy_state_from(*currentCPU);
+            depth_cycle_begin();
+            cpu.profile_begin();
 
-        uint32_t instruction = 0;
+            uint32_t instruction = 0;
 
-        if (ram_accurate)
-        {
-            auto addr_to_bits = [](uint32_t addr, size_t bits)
+            if (ram_accurate)
             {
-                std::vector<bit> result;
-                for (size_t i = 0; i < bits; i++)
+                GATE_SCOPE("fetch");
+                auto addr_to_bits = [](uint32_t addr, size_t bits)
+                {
+                    std::vector<bit> result;
+                    for (size_t i = 0; i < bits; i++)
+                    {
+                        result.push_back(bit((addr >> i) & 1));
+                    }
+                    return result;
+                };
+
+                std::vector<bit> pc_bits = addr_to_bits(current_pc, instruction_memory_slow.get_addr_bits());
+                std::vector<bit> instr_bits = instruction_memory_slow.read(pc_bits);
+
+                for (size_t j = 0; j < 32; j++)
                 {
-                    result.push_back(bit((addr >> i) & 1));
+                    if (instr_bits[j].value())
+                    {
+                        instruction |= (1u << j);
+                    }
                 }
-                return result;
-            };
+            }
+            else
+            {
+                instruction = instruction_memory_fast.at(current_pc);
+            }
 
-            std::vector<bit> pc_bits = addr_to_bits(current_pc, instruction_memory_slow.get_addr_bits());
-            std::vector<bit> instr_bits = instruction_memory_slow.read(pc_bits);
+            if (with_decoder)
+            {
 
-            for (size_t j = 0; j < 32; j++)
+                cpu.execute_instruction_with_decoder_optimized(instruction);
+            }
+            else
             {
-                if (instr_bits[j].value())
-                {
-                    instruction |= (1u << j);
-                }
+                cpu.execute_instruction_without_decoder(instruction);
             }
-        }
-        else
-        {
-            instruction = instruction_memory_fast.at(current_pc);
-        }
+            cpu.commit();
+            cpu.profile_end(instruction);
+            depth_cycle_end(instruction_class(instruction));
 
-        if (with_decoder)
-        {
+            // a jal or branch to itself writes nothing new, so it repeats forever
+            uint32_t opcode = instruction & 0x7F;
+            if (cpu.get_pc() == current_pc && (opcode == 0x6F || opcode == 0x63))
+            {
+                cpu.stop(run_self_loop, "the instruction at " + hex_address(current_pc * 4) + " jumps to itself");
+            }
+            if (options.max_instructions && cpu.instructions_retired() >= options.max_instructions)
+            {
+                cpu.stop(run_instruction_limit, std::to_string(options.max_instructions) + " instructions retired");
+            }
+            if (options.max_gates && !(bit_cost_model::primary().cost() < max_gates))
+            {
+                cpu.stop(run_gate_limit, "more than " + std::to_string(options.max_gates) + " gates");
+            }
+            // the clock is read every 256 instructions
+            if (options.timeout > 0 && cpu.instructions_retired() % 256 == 0 && std::chrono::steady_clock::now() >= deadline)
+            {
+                std::ostringstream reason;
+                reason << "ran for more than " << options.timeout << " seconds";
+                cpu.stop(run_timeout, reason.str());
+            }
 
-            nextCPU->execute_instruction_with_decoder_optimized(instruction);
+            //std::cout<< "\nCURRENT INSTRUCTION IS : "<<std::hex<<instruction<<std::endl;
+            //cpu.print_registers();
+            // cpu.print_details();
+            //getchar();
         }
-        else
-        {
-            nextCPU->execute_instruction_without_decoder(instruction);
-        }
-
-        delete currentCPU;
-        currentCPU = nextCPU;
-
-        bigint current_end_instr_gate_count = bit::ops();
-        bigint current_instr_gate_count = current_end_instr_gate_count - current_start_instr_gate_count;
-    
-        //std::cout<< "\nCURRENT INSTRUCTION IS : "<<std::hex<<instruction<<std::endl;
-        //std::cout << "CURRENT INSTRUCTION TOOK: " << current_instr_gate_count << " GATES" << std::endl;
-        //nextCPU->print_registers();
-        // nextCPU->print_details();
-        //getchar();
     }
-
-    delete currentCPU;
+    catch (const run_finished &finished)
+    {
+        return finished.report;
+    }
 }
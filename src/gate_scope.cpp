@@ -0,0 +1,200 @@
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include "bit_cost_model.h"
+#include "gate_scope.h"
+
+using namespace std;
+
+#if ZEROLOOP_GATE_SCOPES
+
+thread_local gate_scope_node gate_scope::root("total",nullptr);
+thread_local gate_scope_node *gate_scope::current = &gate_scope::root;
+thread_local uint64_t gate_scope::cycle = 0;
+
+// total of a node, including the part so far of a scope still open
+// (the report is printed from inside the exit syscall)
+static bit_ops_counts gate_scope_total(const gate_scope_node &node)
+{
+  if (node.open) return node.total + (bit::counts() - node.start);
+  return node.total;
+}
+
+static void gate_scope_print(ostream &out,const gate_scope_node &node,size_t depth)
+{
+  bit_ops_counts total = gate_scope_total(node);
+  bit_ops_counts self = total;
+  for (const auto &c : node.children)
+    self -= gate_scope_total(*c);
+
+  const bit_cost_model &model = bit_cost_model::primary();
+  out << setw(28) << left << (string(2*depth,' ')+node.name)
+      << setw(12) << left << node.calls
+      << setw(16) << left << model.cost(total)
+      << setw(16) << left << model.cost(self);
+  for (const auto &op : bit_ops_selectors)
+    if (op != bit_ops_cost && total[op])
+      out << " " << bit::opsname(op) << "=" << total[op];
+  out << "\n";
+
+  for (const auto &c : node.children)
+    gate_scope_print(out,*c,depth+1);
+}
+
+void gate_scope_report(ostream &out)
+{
+  if (gate_scope::root.children.empty()) return;
+
+  // everything counted so far, scoped or not, is the root
+  gate_scope::root.total = bit::counts();
+  gate_scope::root.calls = 1;
+
+  out << "\nGate Count Per Scope:\n";
+  out << "-----------------------------\n";
+  out << setw(28) << left << "scope"
+      << setw(12) << left << "calls"
+      << setw(16) << left << "total"
+      << setw(16) << left << "self"
+      << " by gate\n";
+  gate_scope_print(out,gate_scope::root,0);
+}
+
+static void depth_clear(void);
+
+void gate_scope_clear(void)
+{
+  depth_clear();
+  gate_scope::root.children.clear();
+  gate_scope::root.total = bit_ops_counts();
+  gate_scope::root.calls = 0;
+  gate_scope::current = &gate_scope::root;
+}
+
+#else
+
+static void depth_clear(void);
+
+void gate_scope_report(ostream &)
+{
+}
+
+void gate_scope_clear(void)
+{
+  depth_clear();
+}
+
+#endif
+
+#if ZEROLOOP_DEPTH
+
+// depths of one kind of cycle; units are kept by scope path, in the order
+// they were first seen
+struct depth_row {
+  uint64_t cycles = 0;
+  uint64_t critical = 0;
+  double sum = 0;
+  vector<pair<string,uint64_t>> units;
+} ;
+
+static thread_local map<string,depth_row> depth_rows;
+
+static void depth_clear(void)
+{
+  depth_rows.clear();
+}
+
+#if ZEROLOOP_GATE_SCOPES
+static void depth_collect(depth_row &row,const gate_scope_node &node,const string &prefix)
+{
+  for (const auto &c : node.children) {
+    string path = prefix.empty() ? string(c->name) : prefix+"/"+c->name;
+    if (c->depth_cycle == gate_scope::cycle) {
+      auto it = row.units.begin();
+      while (it != row.units.end() && it->first != path) ++it;
+      if (it == row.units.end())
+        row.units.emplace_back(path,c->depth);
+      else
+        it->second = max(it->second,c->depth);
+    }
+    depth_collect(row,*c,path);
+  }
+}
+#endif
+
+void depth_cycle_begin(void)
+{
+  bit_depth::depth_cycle();
+#if ZEROLOOP_GATE_SCOPES
+  ++gate_scope::cycle;
+#endif
+}
+
+void depth_cycle_end(const char *label)
+{
+  depth_row &row = depth_rows[label];
+  uint64_t d = bit_depth::depth_cycle_max();
+  row.cycles += 1;
+  row.critical = max(row.critical,d);
+  row.sum += d;
+#if ZEROLOOP_GATE_SCOPES
+  depth_collect(row,gate_scope::root,"");
+#endif
+}
+
+void depth_report(ostream &out,size_t lanes)
+{
+  if (depth_rows.empty()) return;
+
+  out << "\nLogic Depth Per Cycle (in gate delays):\n";
+  out << "-----------------------------\n";
+  out << setw(12) << left << "class"
+      << setw(12) << left << "cycles"
+      << setw(16) << left << "critical path"
+      << setw(12) << left << "mean"
+      << "deepest units\n";
+
+  string slowest;
+  uint64_t cycle_time = 0;
+  for (const auto &r : depth_rows) {
+    const depth_row &row = r.second;
+    ostringstream mean;
+    mean << fixed << setprecision(1) << row.sum/row.cycles;
+    out << setw(12) << left << r.first
+        << setw(12) << left << row.cycles
+        << setw(16) << left << row.critical
+        << setw(12) << left << mean.str();
+    for (const auto &u : row.units)
+      out << " " << u.first << "=" << u.second;
+    out << "\n";
+    if (row.critical > cycle_time) {
+      cycle_time = row.critical;
+      slowest = r.first;
+    }
+  }
+
+  if (cycle_time == 0) return;
+  out << "\nEstimated cycle time: " << cycle_time << " gate delays (" << slowest << ")\n";
+  out << "Estimated throughput: " << lanes << " instruction(s) per cycle, "
+      << (double) lanes/cycle_time << " per gate delay\n";
+}
+
+#else
+
+static void depth_clear(void)
+{
+}
+
+void depth_cycle_begin(void)
+{
+}
+
+void depth_cycle_end(const char *)
+{
+}
+
+void depth_report(ostream &,size_t)
+{
+}
+
+#endif
@@ -1,33 +1,286 @@
 #include "../include/full_sys.h"
+#include "../include/batch.h"
+#include "../include/sweep.h"
 
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 #include "../include/full_sys.h"
 
+static void print_usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " <vmh_file> <ram_accurate (true/false)> <with_decoder (true/false)> [options]\n"
+              << "       " << name << " --batch=<list file|dir> <ram_accurate> <with_decoder> [options]\n"
+              << "       " << name << " --sweep=<spec file> [options]\n"
+              << "Options:\n"
+              << "  --cost-model=<file>   report gate totals under this cost model (repeatable,\n"
+              << "                        the first one is used for all other totals)\n"
+              << "  --ram=analytic|circuit  charge RAM accesses from closed-form counts (default)\n"
+              << "                        or by simulating the mux tree; both give the same totals\n"
+              << "  --plugin=<file.so>[:<funct7>[-<funct7>]]  load a plug-in unit built with make <dir>/plugin.so,\n"
+              << "                        for custom-0 instructions of these funct7 (repeatable)\n"
+              << "  --plugin-idle=last|zero|evaluate|<gate>=<n>,...  what the plug-in units cost in an\n"
+              << "                        instruction that is not custom-0: the gates of the last custom-0\n"
+              << "                        one (default; none before the first), none, a run of the units,\n"
+              << "                        or this many gates\n"
+              << "  --instr-mem-size=<n>  words of instruction memory (at most " << INSTR_MEM_SIZE << ", the default)\n"
+              << "  --data-mem-size=<n>   words of data memory (default " << DATA_MEM_SIZE << ")\n"
+              << "  --verify-ram-cost     check the closed-form RAM counts against the circuit first\n"
+              << "  --netlist=plugin|counter  record the first custom-0 plug-in instruction, or the\n"
+              << "                        first counter 0 region, as a gate netlist (make NETLIST=1)\n"
+              << "  --netlist-out=<prefix>  write it to <prefix>.bristol and <prefix>.blif (default netlist)\n"
+              << "  --report=json|csv     write exit code, instruction and gate counts, counters and\n"
+              << "                        host time to a file at exit\n"
+              << "  --report-out=<file>   file of --report (default report.json / report.csv)\n"
+              << "  --report-append       with --report=csv, add the row to the table in that file\n"
+              << "  --profile=<prefix>    profile gates per PC and per function, written as folded\n"
+              << "                        stacks to <prefix>.folded and <prefix>.instructions.folded\n"
+              << "  --profile-top=<n>     rows of the profile tables printed at exit (default 20)\n"
+              << "  --annotate[=<file>]   list every executed instruction, disassembled, with its\n"
+              << "                        executions and gates (to the console, or to <file>)\n"
+              << "  --max-instructions=<n>  stop after n retired instructions\n"
+              << "  --max-gates=<n>       stop once the run took n gates (primary cost model)\n"
+              << "  --timeout=<seconds>   stop after this much host time\n"
+              << "                        (stopped runs exit with the status named in the report)\n"
+              << "  --verbose[=<n>]       loader output: 1 (--verbose) a line per image, 2 every word\n"
+              << "  --batch=<list|dir>    run every image of a list file or directory on a thread pool,\n"
+              << "                        with a log and report per program and a pass/fail summary\n"
+              << "  --jobs=<n>            threads of --batch (default: one per hardware thread)\n"
+              << "  --batch-out=<dir>     directory of the --batch output (default batch)\n"
+              << "  --sweep=<spec file>   run the cross product of the images and settings of the spec\n"
+              << "                        on --jobs threads into one results table, resuming earlier runs\n"
+              << "  --simt=<list file>    SIMT batch: run one lane per VMH image listed in the file\n"
+              << "                        (one path per line, up to " << bit_slicing << " images sharing the same text)\n";
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc < 4)
+    std::vector<char *> positional;
+    std::vector<std::string> cost_models;
+    std::string simt_list;
+    std::string batch_list;
+    std::string sweep_spec;
+    RunOptions options;
+    BatchOptions batch;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--cost-model=", 0) == 0)
+        {
+            cost_models.push_back(arg.substr(13));
+        }
+        else if (arg == "--ram=analytic")
+        {
+            options.ram = ram_analytic;
+        }
+        else if (arg == "--ram=circuit")
+        {
+            options.ram = ram_circuit;
+        }
+        else if (arg.rfind("--instr-mem-size=", 0) == 0)
+        {
+            options.instr_mem_words = std::strtoul(arg.c_str() + 17, nullptr, 0);
+        }
+        else if (arg.rfind("--data-mem-size=", 0) == 0)
+        {
+            options.data_mem_words = std::strtoul(arg.c_str() + 16, nullptr, 0);
+        }
+        else if (arg.rfind("--plugin=", 0) == 0)
+        {
+            options.plugins.push_back(arg.substr(9));
+        }
+        else if (arg.rfind("--plugin-idle=", 0) == 0)
+        {
+            try
+            {
+                options.plugin_idle = parse_plugin_idle(arg.substr(14));
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error: " << e.what() << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--verify-ram-cost")
+        {
+            options.verify_ram_cost = true;
+        }
+        else if (arg == "--netlist=plugin")
+        {
+            options.netlist = netlist_plugin;
+        }
+        else if (arg == "--netlist=counter")
+        {
+            options.netlist = netlist_counter;
+        }
+        else if (arg.rfind("--netlist-out=", 0) == 0)
+        {
+            options.netlist_out = arg.substr(14);
+        }
+        else if (arg == "--report=json")
+        {
+            options.report = report_json;
+        }
+        else if (arg == "--report=csv")
+        {
+            options.report = report_csv;
+        }
+        else if (arg.rfind("--report-out=", 0) == 0)
+        {
+            options.report_out = arg.substr(13);
+        }
+        else if (arg == "--report-append")
+        {
+            options.report_append = true;
+        }
+        else if (arg.rfind("--profile=", 0) == 0)
+        {
+            options.profile_out = arg.substr(10);
+        }
+        else if (arg.rfind("--profile-top=", 0) == 0)
+        {
+            options.profile_top = std::strtoul(arg.c_str() + 14, nullptr, 10);
+        }
+        else if (arg == "--annotate")
+        {
+            options.annotate_out = "-";
+        }
+        else if (arg.rfind("--annotate=", 0) == 0)
+        {
+            options.annotate_out = arg.substr(11);
+        }
+        else if (arg.rfind("--max-instructions=", 0) == 0)
+        {
+            options.max_instructions = std::strtoull(arg.c_str() + 19, nullptr, 10);
+        }
+        else if (arg.rfind("--max-gates=", 0) == 0)
+        {
+            options.max_gates = std::strtoull(arg.c_str() + 12, nullptr, 10);
+        }
+        else if (arg.rfind("--timeout=", 0) == 0)
+        {
+            options.timeout = std::strtod(arg.c_str() + 10, nullptr);
+        }
+        else if (arg == "--verbose")
+        {
+            options.verbose = 1;
+        }
+        else if (arg.rfind("--verbose=", 0) == 0)
+        {
+            options.verbose = std::atoi(arg.c_str() + 10);
+        }
+        else if (arg.rfind("--batch=", 0) == 0)
+        {
+            batch_list = arg.substr(8);
+        }
+        else if (arg.rfind("--jobs=", 0) == 0)
+        {
+            batch.jobs = std::strtoul(arg.c_str() + 7, nullptr, 10);
+        }
+        else if (arg.rfind("--batch-out=", 0) == 0)
+        {
+            batch.out_dir = arg.substr(12);
+        }
+        else if (arg.rfind("--sweep=", 0) == 0)
+        {
+            sweep_spec = arg.substr(8);
+        }
+        else if (arg.rfind("--simt=", 0) == 0)
+        {
+            simt_list = arg.substr(7);
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            std::cerr << "Unknown option " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    // a sweep takes everything from its spec
+    if (!sweep_spec.empty())
     {
-        std::cerr << "Usage: " << argv[0] << " <vmh_file> <ram_accurate (true/false)> <with_decoder (true/false)>\n";
+        if (!positional.empty() || !batch_list.empty() || !simt_list.empty())
+        {
+            std::cerr << "--sweep takes no image, --batch or --simt\n";
+            return 1;
+        }
+        try
+        {
+            for (const auto &path : cost_models)
+            {
+                bit_cost_model::select(bit_cost_model::from_file(path));
+            }
+            return run_sweep(sweep_spec, options, batch);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    // a batch takes its images from the list instead of the first argument
+    if (!batch_list.empty())
+    {
+        positional.insert(positional.begin(), nullptr);
+    }
+    if (positional.size() < 3)
+    {
+        print_usage(argv[0]);
         return 1;
     }
+    if (!batch_list.empty() && !simt_list.empty())
+    {
+        std::cerr << "--batch and --simt cannot be combined\n";
+        return 1;
+    }
+    if (options.report_append && options.report != report_csv)
+    {
+        std::cerr << "--report-append needs --report=csv\n";
+        return 1;
+    }
+
+    if (options.report != report_none && options.report_out.empty())
+    {
+        options.report_out = options.report == report_json ? "report.json" : "report.csv";
+    }
 
     // Parse command-line arguments
-    std::string vmh_file = argv[1];
-    bool ram_accurate = (std::string(argv[2]) == "true");
-    bool with_decoder = (std::string(argv[3]) == "true");
+    bool ram_accurate = (std::string(positional[1]) == "true");
+    bool with_decoder = (std::string(positional[2]) == "true");
 
     // Run the full system
     try
     {
-        run_full_system(argv[1], ram_accurate, with_decoder);
+        for (const auto &path : cost_models)
+        {
+            bit_cost_model::select(bit_cost_model::from_file(path));
+        }
+
+        if (!simt_list.empty())
+        {
+            options.simt_images = read_image_list(simt_list);
+        }
+
+        if (!batch_list.empty())
+        {
+            return run_batch(batch_images(batch_list), ram_accurate, with_decoder, options, batch);
+        }
+
+        return run_full_system(positional[0], ram_accurate, with_decoder, options).status;
     }
     catch (const std::exception &e)
     {
         std::cerr << "Error: " << e.what() << "\n";
         return 1;
     }
-
-    return 0;
 }
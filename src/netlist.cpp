@@ -0,0 +1,299 @@
+#include "netlist.h"
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+uint64_t netlist::gates(void) const
+{
+  uint64_t n = 0;
+  for (auto &g : nodes) if (g.op >= 0) n += 1;
+  return n;
+}
+
+// outputs, or the gates nothing used when there are none
+static std::vector<netlist::port> outputs_of(const netlist &n)
+{
+  if (!n.outputs.empty()) return n.outputs;
+  std::vector<bool> used(n.nodes.size());
+  for (auto &g : n.nodes)
+    for (size_t j = 0;j < netlist::arity(g.op);++j) used[g.in[j]] = true;
+  netlist::port sinks = { "y", { } };
+  for (uint64_t k = 0;k < n.nodes.size();++k)
+    if (n.nodes[k].op >= 0 && !used[k]) sinks.nodes.push_back(k);
+  return { sinks };
+}
+
+// nodes the outputs depend on; inputs are kept as part of the interface
+static std::vector<bool> live_nodes(const netlist &n,const std::vector<netlist::port> &outputs)
+{
+  std::vector<bool> live(n.nodes.size());
+  for (auto &p : outputs) for (uint64_t k : p.nodes) live[k] = true;
+  for (uint64_t k = n.nodes.size();k-- > 0;) {
+    const netlist::node &g = n.nodes[k];
+    if (g.op == netlist::node_input) live[k] = true;
+    if (live[k]) for (size_t j = 0;j < netlist::arity(g.op);++j) live[g.in[j]] = true;
+  }
+  return live;
+}
+
+// Bristol Fashion only has XOR, AND, INV (and EQ/EQW for constants and
+// copies), so the other gates are written as small circuits of those;
+// the output wires are the last ones, copied there with EQW
+void netlist::write_bristol(std::ostream &out) const
+{
+  std::vector<port> outs = outputs_of(*this);
+  std::vector<bool> live = live_nodes(*this,outs);
+  std::vector<uint64_t> wire(nodes.size());
+  uint64_t wires = 0;
+  uint64_t lines = 0;
+  std::ostringstream body;
+
+  for (auto &p : inputs) for (uint64_t k : p.nodes) wire[k] = wires++;
+
+  auto gate1 = [&](const char *g,uint64_t a) {
+    body << "1 1 " << a << " " << wires << " " << g << "\n";
+    lines += 1;
+    return wires++;
+  };
+  auto gate2 = [&](const char *g,uint64_t a,uint64_t b) {
+    body << "2 1 " << a << " " << b << " " << wires << " " << g << "\n";
+    lines += 1;
+    return wires++;
+  };
+
+  for (uint64_t k = 0;k < nodes.size();++k) {
+    const node &g = nodes[k];
+    if (!live[k] || g.op == node_input) continue;
+    uint64_t a = g.op >= 0 ? wire[g.in[0]] : 0;
+    uint64_t b = arity(g.op) > 1 ? wire[g.in[1]] : 0;
+    uint64_t c = arity(g.op) > 2 ? wire[g.in[2]] : 0;
+    switch (g.op) {
+      case node_zero: wire[k] = gate1("EQ",0); break;
+      case node_one: wire[k] = gate1("EQ",1); break;
+      case bit_ops_not: wire[k] = gate1("INV",a); break;
+      case bit_ops_xor: wire[k] = gate2("XOR",a,b); break;
+      case bit_ops_and: wire[k] = gate2("AND",a,b); break;
+      case bit_ops_or: wire[k] = gate2("XOR",gate2("XOR",a,b),gate2("AND",a,b)); break;
+      case bit_ops_xnor: wire[k] = gate1("INV",gate2("XOR",a,b)); break;
+      case bit_ops_andn: wire[k] = gate2("AND",a,gate1("INV",b)); break;
+      case bit_ops_nand: wire[k] = gate1("INV",gate2("AND",a,b)); break;
+      case bit_ops_orn: wire[k] = gate1("INV",gate2("AND",gate1("INV",a),b)); break;
+      case bit_ops_nor: wire[k] = gate2("AND",gate1("INV",a),gate1("INV",b)); break;
+      // s ? c : b, as b ^ (s & (b ^ c))
+      case bit_ops_mux: wire[k] = gate2("XOR",b,gate2("AND",a,gate2("XOR",b,c))); break;
+      default: throw std::runtime_error("netlist: unexpected gate");
+    }
+  }
+
+  for (auto &p : outs) for (uint64_t k : p.nodes) gate1("EQW",wire[k]);
+
+  out << lines << " " << wires << "\n";
+  out << inputs.size();
+  for (auto &p : inputs) out << " " << p.nodes.size();
+  out << "\n" << outs.size();
+  for (auto &p : outs) out << " " << p.nodes.size();
+  out << "\n\n" << body.str();
+}
+
+void netlist::write_blif(std::ostream &out,const std::string &model) const
+{
+  std::vector<port> outs = outputs_of(*this);
+  std::vector<bool> live = live_nodes(*this,outs);
+  std::vector<std::string> name(nodes.size());
+  for (uint64_t k = 0;k < nodes.size();++k) name[k] = "n" + std::to_string(k);
+  for (auto &p : inputs)
+    for (size_t i = 0;i < p.nodes.size();++i) name[p.nodes[i]] = p.name + "[" + std::to_string(i) + "]";
+
+  out << ".model " << model << "\n.inputs";
+  for (auto &p : inputs) for (uint64_t k : p.nodes) out << " " << name[k];
+  out << "\n.outputs";
+  for (auto &p : outs) for (size_t i = 0;i < p.nodes.size();++i) out << " " << p.name << "[" << i << "]";
+  out << "\n";
+
+  for (uint64_t k = 0;k < nodes.size();++k) {
+    const node &g = nodes[k];
+    if (!live[k] || g.op == node_input) continue;
+    out << ".names";
+    for (size_t j = 0;j < arity(g.op);++j) out << " " << name[g.in[j]];
+    out << " " << name[k] << "\n";
+    switch (g.op) {
+      case node_zero: break;
+      case node_one: out << "1\n"; break;
+      case bit_ops_not: out << "0 1\n"; break;
+      case bit_ops_xor: out << "10 1\n01 1\n"; break;
+      case bit_ops_and: out << "11 1\n"; break;
+      case bit_ops_or: out << "1- 1\n-1 1\n"; break;
+      case bit_ops_xnor: out << "00 1\n11 1\n"; break;
+      case bit_ops_andn: out << "10 1\n"; break;
+      case bit_ops_nand: out << "0- 1\n-0 1\n"; break;
+      case bit_ops_orn: out << "1- 1\n-0 1\n"; break;
+      case bit_ops_nor: out << "00 1\n"; break;
+      case bit_ops_mux: out << "01- 1\n1-1 1\n"; break;
+      default: throw std::runtime_error("netlist: unexpected gate");
+    }
+  }
+
+  for (auto &p : outs)
+    for (size_t i = 0;i < p.nodes.size();++i)
+      out << ".names " << name[p.nodes[i]] << " " << p.name << "[" << i << "]\n1 1\n";
+  out << ".end\n";
+}
+
+void netlist::write_summary(std::ostream &out) const
+{
+  uint64_t ins = 0,outs = 0;
+  for (auto &p : inputs) ins += p.nodes.size();
+  for (auto &p : outputs_of(*this)) outs += p.nodes.size();
+  out << "Netlist: " << gates() << " gates, " << ins << " inputs, " << outs << " outputs ("
+      << executed << " gates executed, " << executed - gates() << " shared)\n";
+
+  // a cswap is recorded as its two muxes
+  uint64_t charged = 0;
+  for (auto t : bit_ops_selectors) if (t != bit_ops_cost) charged += counted[t];
+  charged += counted[bit_ops_cswap];
+  if (charged > executed)
+    out << "Note: " << charged - executed << " gates were charged from closed forms without being"
+        << " simulated (analytic RAM) and are not in the netlist; run with --ram=circuit to record them\n";
+}
+
+void netlist::save(const std::string &prefix,const std::string &model) const
+{
+  std::ofstream bristol(prefix + ".bristol");
+  std::ofstream blif(prefix + ".blif");
+  if (!bristol.is_open() || !blif.is_open())
+    throw std::runtime_error("Could not write netlist " + prefix + ".bristol/.blif");
+  write_bristol(bristol);
+  write_blif(blif,model);
+}
+
+#if ZEROLOOP_NETLIST
+
+thread_local bool bit_wire::recording = false;
+thread_local uint64_t bit_wire::first = 1;
+
+namespace {
+
+struct gate_key {
+  int op;
+  uint64_t in[3];
+  bool operator==(const gate_key &k) const { return op == k.op && in[0] == k.in[0] && in[1] == k.in[1] && in[2] == k.in[2]; }
+} ;
+
+struct gate_key_hash {
+  size_t operator()(const gate_key &k) const {
+    uint64_t h = k.op;
+    for (int j = 0;j < 3;++j) h = (h ^ k.in[j]) * 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 29);
+  }
+} ;
+
+thread_local std::unique_ptr<netlist> active;
+thread_local std::unordered_map<gate_key,uint64_t,gate_key_hash> shared;
+thread_local netlist::port autos;
+thread_local uint64_t constants[2];
+thread_local bit_ops_counts start;
+
+uint64_t add_node(int op,const uint64_t *in)
+{
+  netlist::node g = { op, { 0, 0, 0 } };
+  for (size_t j = 0;j < netlist::arity(op);++j) g.in[j] = in[j];
+  active->nodes.push_back(g);
+  return active->nodes.size() - 1;
+}
+
+bool commutative(int op)
+{
+  return op == bit_ops_xor || op == bit_ops_and || op == bit_ops_or
+      || op == bit_ops_xnor || op == bit_ops_nand || op == bit_ops_nor;
+}
+
+}
+
+uint64_t bit_wire::netlist_wire(void) const
+{
+  if (wire < first) {
+    uint64_t k = add_node(netlist::node_input,nullptr);
+    autos.nodes.push_back(k);
+    wire = first + k;
+  }
+  return wire;
+}
+
+uint64_t bit_wire::record(int op,std::initializer_list<uint64_t> in)
+{
+  gate_key key = { op, { 0, 0, 0 } };
+  size_t j = 0;
+  for (uint64_t w : in) key.in[j++] = w - first;
+  if (commutative(op) && key.in[1] < key.in[0]) std::swap(key.in[0],key.in[1]);
+
+  active->executed += 1;
+  auto it = shared.find(key);
+  if (it != shared.end()) return first + it->second;
+  uint64_t k = add_node(op,key.in);
+  shared.emplace(key,k);
+  return first + k;
+}
+
+uint64_t bit_wire::constant(bool v)
+{
+  if (constants[v] == UINT64_MAX) constants[v] = add_node(v ? netlist::node_one : netlist::node_zero,nullptr);
+  return first + constants[v];
+}
+
+void netlist_recorder::begin(void)
+{
+  if (active) throw std::runtime_error("A netlist is already being recorded");
+  active.reset(new netlist);
+  shared.clear();
+  autos = { "x", { } };
+  constants[0] = constants[1] = UINT64_MAX;
+  start = bit::counts();
+  bit_wire::recording = true;
+}
+
+void netlist_recorder::input(const std::string &name,bit *bits,size_t n)
+{
+  netlist::port p = { name, { } };
+  for (size_t i = 0;i < n;++i) {
+    uint64_t k = add_node(netlist::node_input,nullptr);
+    bits[i].netlist_set(bit_wire::first + k);
+    p.nodes.push_back(k);
+  }
+  active->inputs.push_back(p);
+}
+
+void netlist_recorder::output(const std::string &name,const bit *bits,size_t n)
+{
+  netlist::port p = { name, { } };
+  for (size_t i = 0;i < n;++i) p.nodes.push_back(bits[i].netlist_wire() - bit_wire::first);
+  active->outputs.push_back(p);
+}
+
+netlist netlist_recorder::end(void)
+{
+  bit_wire::recording = false;
+  netlist n = std::move(*active);
+  active.reset();
+  shared.clear();
+  if (!autos.nodes.empty()) n.inputs.push_back(autos);
+  n.counted = bit::counts() - start;
+  // wires of this recording now predate the next one
+  bit_wire::first += n.nodes.size();
+  return n;
+}
+
+#else
+
+void netlist_recorder::begin(void)
+{
+  throw std::runtime_error("Netlist recording needs a build with make NETLIST=1");
+}
+
+void netlist_recorder::input(const std::string &,bit *,size_t) { }
+void netlist_recorder::output(const std::string &,const bit *,size_t) { }
+netlist netlist_recorder::end(void) { return netlist(); }
+
+#endif
@@ -40,6 +40,10 @@ void PC::update_pc_brj(bigint new_pc_val) {
     current_pc.update_data(new_pc_val);
 }
 
+void PC::update_pc_brj(uint32_t new_pc_val) {
+    current_pc = Register(new_pc_val, current_pc.width());
+}
+
 uint32_t PC::read_pc() {
     return current_pc.get_data_uint();
 }
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "plugin_units.h"
+
+#include <dlfcn.h>
+
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+static std::mutex loaded_lock;
+static std::map<std::string, const zeroloop_plugin_info *> loaded;
+
+// Offset of the ":<funct7>[-<funct7>]" binding in spec, or npos
+static size_t binding_start(const std::string &spec)
+{
+    size_t colon = spec.rfind(':');
+    if (colon == std::string::npos || colon + 1 == spec.size())
+        return std::string::npos;
+    if (spec.find_first_not_of("0123456789abcdefxABCDEFX-", colon + 1) != std::string::npos)
+        return std::string::npos;
+    return colon;
+}
+
+static uint32_t parse_funct7(const std::string &spec, const std::string &value)
+{
+    size_t end = 0;
+    unsigned long n = 0;
+    try { n = std::stoul(value, &end, 0); } catch (const std::exception &) { end = 0; }
+    if (end != value.size() || n > 127)
+        throw std::runtime_error("--plugin=" + spec + ": bad funct7 " + value);
+    return n;
+}
+
+static const zeroloop_plugin_info *open_plugin(const std::string &path)
+{
+    std::lock_guard<std::mutex> guard(loaded_lock);
+    auto found = loaded.find(path);
+    if (found != loaded.end())
+        return found->second;
+
+    // the path is relative to the working directory, as for the images
+    std::string file = path.find('/') == std::string::npos ? "./" + path : path;
+    void *handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+        throw std::runtime_error("Could not load plug-in " + path + ": " + dlerror());
+
+    auto entry = (const zeroloop_plugin_info *(*)(void))dlsym(handle, ZEROLOOP_PLUGIN_ENTRY);
+    if (!entry)
+        throw std::runtime_error(path + " has no " ZEROLOOP_PLUGIN_ENTRY "(); build it with -DZEROLOOP_PLUGIN_SO");
+
+    const zeroloop_plugin_info *info = entry();
+    if (info->abi != ZEROLOOP_PLUGIN_ABI)
+        throw std::runtime_error(path + " was built for plug-in ABI " + std::to_string(info->abi) +
+                                 ", the emulator has " + std::to_string(ZEROLOOP_PLUGIN_ABI));
+    if (info->lanes != ZEROLOOP_LANES || info->gate_scopes != ZEROLOOP_GATE_SCOPES ||
+        info->depth != ZEROLOOP_DEPTH || info->netlist != ZEROLOOP_NETLIST || info->register_size != sizeof(Register))
+    {
+        throw std::runtime_error(path + " was built with LANES=" + std::to_string(info->lanes) +
+                                 " SCOPES=" + std::to_string(info->gate_scopes) + " DEPTH=" + std::to_string(info->depth) +
+                                 " NETLIST=" + std::to_string(info->netlist) + ", the emulator with LANES=" +
+                                 std::to_string(ZEROLOOP_LANES) + " SCOPES=" + std::to_string(ZEROLOOP_GATE_SCOPES) +
+                                 " DEPTH=" + std::to_string(ZEROLOOP_DEPTH) + " NETLIST=" + std::to_string(ZEROLOOP_NETLIST));
+    }
+    // never unloaded: the units stay in use until the process exits
+    loaded[path] = info;
+    return info;
+}
+
+std::string plugin_unit_path(const std::string &spec)
+{
+    return spec.substr(0, binding_start(spec));
+}
+
+plugin_unit load_plugin_unit(const std::string &spec)
+{
+    plugin_unit unit;
+    unit.path = plugin_unit_path(spec);
+    unit.info = open_plugin(unit.path);
+    unit.funct7_first = unit.info->funct7_first;
+    unit.funct7_last = unit.info->funct7_last;
+
+    size_t colon = binding_start(spec);
+    if (colon != std::string::npos)
+    {
+        std::string range = spec.substr(colon + 1);
+        size_t dash = range.find('-');
+        unit.funct7_first = parse_funct7(spec, range.substr(0, dash));
+        unit.funct7_last = dash == std::string::npos ? unit.funct7_first : parse_funct7(spec, range.substr(dash + 1));
+    }
+    if (unit.funct7_first > unit.funct7_last || unit.funct7_last > 127)
+        throw std::runtime_error("--plugin=" + spec + ": empty funct7 range");
+    return unit;
+}
+
+std::vector<plugin_unit> load_plugin_units(const std::vector<std::string> &specs)
+{
+    std::vector<plugin_unit> units;
+    for (const auto &spec : specs)
+    {
+        plugin_unit unit = load_plugin_unit(spec);
+        for (const auto &other : units)
+        {
+            if (unit.funct7_first <= other.funct7_last && other.funct7_first <= unit.funct7_last)
+                throw std::runtime_error("Plug-ins " + other.path + " and " + unit.path + " are bound to the same funct7; "
+                                         "bind them to ranges of their own with --plugin=<file.so>:<first>-<last>");
+        }
+        units.push_back(unit);
+    }
+    return units;
+}
+
+plugin_idle_cost parse_plugin_idle(const std::string &arg)
+{
+    plugin_idle_cost idle;
+    if (arg == "last")
+        return idle;
+    if (arg == "zero")
+    {
+        idle.policy = plugin_idle_zero;
+        return idle;
+    }
+    if (arg == "evaluate")
+    {
+        idle.policy = plugin_idle_evaluate;
+        return idle;
+    }
+
+    idle.policy = plugin_idle_static;
+    std::istringstream in(arg);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        size_t equals = item.find('=');
+        std::string gate = item.substr(0, equals);
+        bool found = false;
+        for (const auto &t : bit_ops_selectors)
+        {
+            if (t == bit_ops_cost || gate != bit::opsname(t))
+                continue;
+            std::string value = equals == std::string::npos ? "" : item.substr(equals + 1);
+            size_t end = 0;
+            unsigned long long n = 0;
+            try { n = std::stoull(value, &end); } catch (const std::exception &) { end = 0; }
+            if (end == 0 || end != value.size())
+                throw std::runtime_error("--plugin-idle=" + arg + ": bad count for " + gate);
+            idle.gates[t] = n;
+            found = true;
+        }
+        if (!found)
+            throw std::runtime_error("--plugin-idle=" + arg + ": expected last, zero, evaluate or <gate>=<n>,...; "
+                                     "unknown gate " + gate);
+    }
+    return idle;
+}
+
+std::string plugin_idle_name(const plugin_idle_cost &idle)
+{
+    switch (idle.policy)
+    {
+    case plugin_idle_last: return "last";
+    case plugin_idle_zero: return "zero";
+    case plugin_idle_evaluate: return "evaluate";
+    default: break;
+    }
+    std::string figure;
+    for (const auto &t : bit_ops_selectors)
+    {
+        if (t != bit_ops_cost && idle.gates[t])
+            figure += (figure.empty() ? "" : ",") + std::string(bit::opsname(t)) + "=" + std::to_string(idle.gates[t]);
+    }
+    return figure.empty() ? "zero" : figure;
+}
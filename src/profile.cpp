@@ -0,0 +1,324 @@
+#include "profile.h"
+#include "bit_cost_model.h"
+#include "disassembler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+static std::string hex_address(uint32_t address)
+{
+    std::ostringstream s;
+    s << "0x" << std::hex << address;
+    return s.str();
+}
+
+// ra and t0 are the link registers of the RISC-V calling convention
+static bool is_link(uint32_t reg)
+{
+    return reg == 1 || reg == 5;
+}
+
+Profiler::Profiler(const ProgramImage &image) : current_entry(image.entry)
+{
+    program.entry = image.entry;
+    program.symbols = image.symbols;
+
+    Frame root;
+    root.parent = 0;
+    root.function = -1;
+    frames.push_back(root);
+}
+
+int Profiler::function_id(const std::string &name)
+{
+    auto it = function_ids.find(name);
+    if (it != function_ids.end())
+        return it->second;
+    functions.push_back(name);
+    function_ids[name] = functions.size() - 1;
+    return functions.size() - 1;
+}
+
+int Profiler::function_at(uint32_t pc)
+{
+    if (program.symbols.empty())
+        return function_id(hex_address(current_entry));
+
+    PcStats &stats = pcs[pc];
+    if (stats.function < 0)
+    {
+        const ProgramSymbol *symbol = program.symbol_at(pc);
+        stats.function = function_id(symbol ? symbol->name : hex_address(pc));
+    }
+    return stats.function;
+}
+
+uint32_t Profiler::frame_of(uint32_t caller, int function)
+{
+    auto it = frames[caller].children.find(function);
+    if (it != frames[caller].children.end())
+        return it->second;
+
+    Frame frame;
+    frame.parent = caller;
+    frame.function = function;
+    frames.push_back(frame);
+    uint32_t id = frames.size() - 1;
+    frames[caller].children[function] = id;
+    return id;
+}
+
+std::string Profiler::stack_name(uint32_t frame) const
+{
+    std::vector<int> stack;
+    for (uint32_t f = frame; f != 0; f = frames[f].parent)
+        stack.push_back(frames[f].function);
+
+    std::string name;
+    for (size_t i = stack.size(); i-- > 0;)
+    {
+        name += functions[stack[i]];
+        if (i)
+            name += ";";
+    }
+    return name;
+}
+
+void Profiler::retire(uint32_t pc, uint32_t instruction, uint32_t next_pc,
+                      const bit_ops_counts &cpu, const bit_ops_counts &memory, const bit_ops_counts &plugin)
+{
+    uint32_t frame = frame_of(caller_frame(), function_at(pc));
+    PcStats &stats = pcs[pc];
+    stats.instructions += 1;
+    stats.instruction = instruction;
+    stats.cpu += cpu - plugin;
+    stats.memory += memory;
+    stats.plugin += plugin;
+    frames[frame].instructions += 1;
+    frames[frame].gates += cpu + memory;
+
+    uint32_t opcode = instruction & 0x7F;
+    uint32_t rd = (instruction >> 7) & 0x1F;
+    uint32_t rs1 = (instruction >> 15) & 0x1F;
+    bool call = false, ret = false;
+    if (opcode == 0x6F) // jal
+    {
+        call = is_link(rd);
+    }
+    else if (opcode == 0x67) // jalr
+    {
+        call = is_link(rd);
+        ret = is_link(rs1) && (!is_link(rd) || rd != rs1);
+    }
+
+    if (ret)
+    {
+        // unwind to the call this returns from; an unmatched return (e.g.
+        // into code entered without a call) leaves the stack alone
+        for (size_t i = calls.size(); i-- > 0;)
+        {
+            if (calls[i].return_address == next_pc)
+            {
+                calls.resize(i);
+                current_entry = calls.empty() ? program.entry : calls.back().function;
+                break;
+            }
+        }
+    }
+    if (call)
+    {
+        calls.push_back({pc + 4, frame, next_pc});
+        current_entry = next_pc;
+    }
+}
+
+void Profiler::write_folded(std::ostream &out, bool by_gates) const
+{
+    const bit_cost_model &primary = bit_cost_model::primary();
+    for (uint32_t f = 1; f < frames.size(); f++)
+    {
+        if (frames[f].instructions == 0)
+            continue;
+        out << stack_name(f) << " ";
+        if (by_gates)
+            out << primary.cost(frames[f].gates);
+        else
+            out << frames[f].instructions;
+        out << "\n";
+    }
+}
+
+void Profiler::write_top(std::ostream &out, size_t n) const
+{
+    const bit_cost_model &primary = bit_cost_model::primary();
+
+    // self and inclusive totals per function; a function recursing is
+    // counted once per stack for its inclusive total
+    struct FunctionStats
+    {
+        uint64_t instructions = 0;
+        bit_ops_counts self, total;
+    };
+    std::vector<FunctionStats> by_function(functions.size());
+    for (uint32_t f = 1; f < frames.size(); f++)
+    {
+        const Frame &frame = frames[f];
+        by_function[frame.function].instructions += frame.instructions;
+        by_function[frame.function].self += frame.gates;
+        std::set<int> seen;
+        for (uint32_t g = f; g != 0; g = frames[g].parent)
+        {
+            if (seen.insert(frames[g].function).second)
+                by_function[frames[g].function].total += frame.gates;
+        }
+    }
+
+    std::vector<std::pair<bigint, int>> order;
+    for (size_t i = 0; i < by_function.size(); i++)
+        order.push_back({primary.cost(by_function[i].self), (int)i});
+    std::stable_sort(order.begin(), order.end(),
+                     [](const std::pair<bigint, int> &a, const std::pair<bigint, int> &b) { return b.first < a.first; });
+
+    out << "\nProfile by function (top " << n << "):\n";
+    out << "-----------------------------\n";
+    out << std::setw(28) << std::left << "function"
+        << std::setw(14) << std::left << "instructions"
+        << std::setw(16) << std::left << "self gates"
+        << "total gates\n";
+    for (size_t i = 0; i < order.size() && i < n; i++)
+    {
+        const FunctionStats &stats = by_function[order[i].second];
+        out << std::setw(28) << std::left << functions[order[i].second]
+            << std::setw(14) << std::left << stats.instructions
+            << std::setw(16) << std::left << order[i].first
+            << primary.cost(stats.total) << "\n";
+    }
+
+    std::vector<std::pair<bigint, uint32_t>> pc_order;
+    for (const auto &entry : pcs)
+    {
+        if (entry.second.instructions)
+            pc_order.push_back({primary.cost(entry.second.cpu + entry.second.memory + entry.second.plugin), entry.first});
+    }
+    std::sort(pc_order.begin(), pc_order.end(),
+              [](const std::pair<bigint, uint32_t> &a, const std::pair<bigint, uint32_t> &b)
+              { return b.first < a.first || (!(a.first < b.first) && a.second < b.second); });
+
+    out << "\nProfile by PC (top " << n << "):\n";
+    out << "-----------------------------\n";
+    out << std::setw(12) << std::left << "pc"
+        << std::setw(28) << std::left << "where"
+        << std::setw(14) << std::left << "instructions"
+        << std::setw(16) << std::left << "gates"
+        << std::setw(16) << std::left << "cpu"
+        << std::setw(16) << std::left << "memory"
+        << "plugin\n";
+    for (size_t i = 0; i < pc_order.size() && i < n; i++)
+    {
+        uint32_t pc = pc_order[i].second;
+        const PcStats &stats = pcs.at(pc);
+        const ProgramSymbol *symbol = program.symbol_at(pc);
+        std::string where = symbol ? symbol->name + "+" + hex_address(pc - symbol->address) : "";
+        out << std::setw(12) << std::left << hex_address(pc)
+            << std::setw(28) << std::left << where
+            << std::setw(14) << std::left << stats.instructions
+            << std::setw(16) << std::left << pc_order[i].first
+            << std::setw(16) << std::left << primary.cost(stats.cpu)
+            << std::setw(16) << std::left << primary.cost(stats.memory)
+            << primary.cost(stats.plugin) << "\n";
+    }
+}
+
+void Profiler::write_annotated(std::ostream &out) const
+{
+    const bit_cost_model &primary = bit_cost_model::primary();
+
+    std::vector<uint32_t> order;
+    bit_ops_counts total;
+    for (const auto &entry : pcs)
+    {
+        if (entry.second.instructions)
+        {
+            order.push_back(entry.first);
+            total += entry.second.cpu + entry.second.memory + entry.second.plugin;
+        }
+    }
+    std::sort(order.begin(), order.end());
+    bigint total_cost = primary.cost(total);
+
+    out << "\nAnnotated disassembly:\n";
+    out << "-----------------------------\n";
+    out << std::setw(12) << std::left << "executions"
+        << std::setw(14) << std::left << "gates"
+        << std::setw(8) << std::left << "%"
+        << std::setw(12) << std::left << "per exec"
+        << std::setw(14) << std::left << "cpu"
+        << std::setw(14) << std::left << "memory"
+        << std::setw(10) << std::left << "plugin"
+        << "instruction\n";
+
+    const ProgramSymbol *last = nullptr;
+    uint32_t next = 0;
+    for (uint32_t pc : order)
+    {
+        const ProgramSymbol *symbol = program.symbol_at(pc);
+        if (symbol != last && symbol && symbol->address <= pc)
+        {
+            out << "\n" << std::setfill('0') << std::setw(8) << std::right << std::hex << symbol->address
+                << std::dec << std::setfill(' ') << " <" << symbol->name << ">:\n";
+        }
+        else if (pc != next && pc != order.front())
+        {
+            out << std::setw(96) << std::left << "" << "...\n";
+        }
+        last = symbol;
+        next = pc + 4;
+
+        const PcStats &stats = pcs.at(pc);
+        bigint gates = primary.cost(stats.cpu + stats.memory + stats.plugin);
+        // share of all gates, in hundredths of a percent
+        std::ostringstream basis;
+        basis << (total_cost == 0 ? bigint(0) : gates * 10000 / total_cost);
+        unsigned long share = std::stoul(basis.str());
+        std::ostringstream percent;
+        percent << share / 100 << "." << std::setfill('0') << std::setw(2) << share % 100;
+        std::ostringstream address;
+        address << std::setw(8) << std::right << std::hex << pc << ":  " << std::setfill('0') << std::setw(8)
+                << stats.instruction;
+
+        out << std::setw(12) << std::left << stats.instructions
+            << std::setw(14) << std::left << gates
+            << std::setw(8) << std::left << percent.str()
+            << std::setw(12) << std::left << gates / bigint(stats.instructions)
+            << std::setw(14) << std::left << primary.cost(stats.cpu)
+            << std::setw(14) << std::left << primary.cost(stats.memory)
+            << std::setw(10) << std::left << primary.cost(stats.plugin)
+            << address.str() << "  " << disassemble(stats.instruction, pc) << "\n";
+    }
+}
+
+void Profiler::save(const std::string &prefix) const
+{
+    std::ofstream gates(prefix + ".folded");
+    std::ofstream instructions(prefix + ".instructions.folded");
+    if (!gates.is_open() || !instructions.is_open())
+    {
+        throw std::runtime_error("Could not write profile " + prefix + ".folded");
+    }
+    write_folded(gates, true);
+    write_folded(instructions, false);
+}
+
+void Profiler::save_annotated(const std::string &path) const
+{
+    std::ofstream out(path);
+    if (!out.is_open())
+    {
+        throw std::runtime_error("Could not write annotated disassembly " + path);
+    }
+    write_annotated(out);
+}
@@ -0,0 +1,331 @@
+#include "program_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+// Read-only mapping of a whole file, unmapped when it goes out of scope
+class mapped_file
+{
+    int fd;
+    void *base;
+    size_t length;
+
+public:
+    explicit mapped_file(const char *path) : fd(-1), base(nullptr), length(0)
+    {
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error(std::string("Could not open program image ") + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            throw std::runtime_error(std::string("Could not stat program image ") + path);
+        }
+        length = st.st_size;
+        if (length > 0)
+        {
+            base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (base == MAP_FAILED)
+            {
+                close(fd);
+                throw std::runtime_error(std::string("Could not map program image ") + path);
+            }
+        }
+    }
+    ~mapped_file()
+    {
+        if (base)
+            munmap(base, length);
+        close(fd);
+    }
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    const char *data() const { return static_cast<const char *>(base); }
+    size_t size() const { return length; }
+};
+
+int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+uint32_t read_le32(const char *p)
+{
+    const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+    return (uint32_t)u[0] | ((uint32_t)u[1] << 8) | ((uint32_t)u[2] << 16) | ((uint32_t)u[3] << 24);
+}
+
+uint16_t read_le16(const char *p)
+{
+    const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+    return (uint16_t)(u[0] | (u[1] << 8));
+}
+
+const char ELF_MAGIC[] = "\x7f" "ELF";
+
+// ELF32 fields used here (System V ABI)
+enum
+{
+    EI_CLASS = 4,
+    EI_DATA = 5,
+    ELFCLASS32 = 1,
+    ELFDATA2LSB = 1,
+    EM_RISCV = 243,
+    PT_LOAD = 1,
+    SHT_SYMTAB = 2,
+    SHF_EXECINSTR = 4,
+    STT_NOTYPE = 0,
+    STT_OBJECT = 1,
+    STT_FUNC = 2,
+    SHN_UNDEF = 0,
+    SHN_LORESERVE = 0xff00,
+};
+
+// Bounds-checked view of the mapped ELF file
+struct elf_file
+{
+    const char *path;
+    const char *base;
+    size_t size;
+
+    const char *at(uint64_t offset, uint64_t bytes) const
+    {
+        if (offset > size || bytes > size - offset)
+        {
+            throw std::runtime_error(std::string(path) + ": ELF file is truncated");
+        }
+        return base + offset;
+    }
+    uint32_t u32(uint64_t offset) const { return read_le32(at(offset, 4)); }
+    uint16_t u16(uint64_t offset) const { return read_le16(at(offset, 2)); }
+};
+
+void parse_elf(const char *path, const char *p, size_t size, ProgramImage &image)
+{
+    elf_file elf = {path, p, size};
+    const char *ident = elf.at(0, 16);
+    if (ident[EI_CLASS] != ELFCLASS32 || ident[EI_DATA] != ELFDATA2LSB || elf.u16(18) != EM_RISCV)
+    {
+        throw std::runtime_error(std::string(path) + ": not a little-endian ELF32 RISC-V executable");
+    }
+
+    image.entry = elf.u32(24);
+    uint32_t phoff = elf.u32(28);
+    uint32_t shoff = elf.u32(32);
+    uint16_t phentsize = elf.u16(42);
+    uint16_t phnum = elf.u16(44);
+    uint16_t shentsize = elf.u16(46);
+    uint16_t shnum = elf.u16(48);
+
+    for (uint16_t i = 0; i < phnum; i++)
+    {
+        uint64_t ph = phoff + (uint64_t)i * phentsize;
+        if (elf.u32(ph) != PT_LOAD)
+            continue;
+        uint32_t offset = elf.u32(ph + 4);
+        uint32_t vaddr = elf.u32(ph + 8);
+        uint32_t filesz = elf.u32(ph + 16);
+        uint32_t memsz = elf.u32(ph + 20);
+        if (vaddr % 4 != 0)
+        {
+            throw std::runtime_error(std::string(path) + ": segment not word aligned");
+        }
+
+        // a last partial word is completed with the zeros that follow it
+        const char *bytes = elf.at(offset, filesz);
+        for (uint32_t b = 0; b < filesz; b += 4)
+        {
+            char word[4] = {0, 0, 0, 0};
+            memcpy(word, bytes + b, std::min<uint32_t>(4, filesz - b));
+            image.words.push_back({vaddr + b, read_le32(word)});
+        }
+        uint32_t loaded = (filesz + 3) & ~3u;
+        if (memsz > loaded)
+        {
+            image.zero.push_back({vaddr + loaded, memsz - loaded});
+        }
+    }
+
+    for (uint16_t i = 0; i < shnum; i++)
+    {
+        uint64_t sh = shoff + (uint64_t)i * shentsize;
+        if (elf.u32(sh + 4) != SHT_SYMTAB)
+            continue;
+        uint32_t symoff = elf.u32(sh + 16);
+        uint32_t symsize = elf.u32(sh + 20);
+        uint32_t entsize = elf.u32(sh + 36);
+        uint32_t link = elf.u32(sh + 24);
+        uint64_t strsh = shoff + (uint64_t)link * shentsize;
+        uint32_t stroff = elf.u32(strsh + 16);
+        uint32_t strsize = elf.u32(strsh + 20);
+        const char *strtab = elf.at(stroff, strsize);
+        if (entsize < 16)
+        {
+            throw std::runtime_error(std::string(path) + ": bad symbol table");
+        }
+
+        for (uint64_t sym = symoff; sym + entsize <= (uint64_t)symoff + symsize; sym += entsize)
+        {
+            uint32_t name = elf.u32(sym);
+            uint8_t type = *elf.at(sym + 12, 1) & 0xF;
+            uint16_t shndx = elf.u16(sym + 14);
+            if (name == 0 || name >= strsize || shndx == SHN_UNDEF || shndx >= SHN_LORESERVE)
+                continue;
+            if (type != STT_NOTYPE && type != STT_OBJECT && type != STT_FUNC)
+                continue;
+            const char *symbol_name = strtab + name;
+            size_t length = strnlen(symbol_name, strsize - name);
+            // assembler-local labels
+            if (length >= 2 && symbol_name[0] == '.' && symbol_name[1] == 'L')
+                continue;
+
+            uint32_t flags = elf.u32(shoff + (uint64_t)shndx * shentsize + 8);
+            image.symbols.push_back({std::string(symbol_name, length), elf.u32(sym + 4), elf.u32(sym + 8),
+                                     (flags & SHF_EXECINSTR) != 0});
+        }
+    }
+
+    std::stable_sort(image.symbols.begin(), image.symbols.end(),
+                     [](const ProgramSymbol &a, const ProgramSymbol &b) { return a.address < b.address; });
+}
+
+void parse_binary(const char *path, const char *p, const char *end, std::vector<std::pair<uint32_t, uint32_t>> &words)
+{
+    p += strlen(PROGRAM_IMAGE_MAGIC);
+    while (p < end)
+    {
+        if (end - p < 8)
+        {
+            throw std::runtime_error(std::string(path) + ": truncated segment header");
+        }
+        uint32_t address = read_le32(p);
+        uint32_t count = read_le32(p + 4);
+        p += 8;
+        if ((uint64_t)(end - p) / 4 < count)
+        {
+            throw std::runtime_error(std::string(path) + ": truncated segment");
+        }
+        for (uint32_t i = 0; i < count; i++, p += 4)
+        {
+            words.push_back({address + 4 * i, read_le32(p)});
+        }
+    }
+}
+
+void parse_vmh(const char *path, const char *p, const char *end, std::vector<std::pair<uint32_t, uint32_t>> &words)
+{
+    uint32_t current_addr = 0;
+    size_t line = 1;
+
+    while (p < end)
+    {
+        char c = *p;
+        if (c == '\n')
+        {
+            line++;
+            p++;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r')
+        {
+            p++;
+            continue;
+        }
+
+        bool is_address = c == '@';
+        if (is_address)
+            p++;
+
+        uint64_t value = 0;
+        const char *start = p;
+        for (int d; p < end && (d = hex_digit(*p)) >= 0; p++)
+        {
+            value = (value << 4) | d;
+            if (value > 0xFFFFFFFFu)
+            {
+                throw std::runtime_error(std::string(path) + ":" + std::to_string(line) + ": value does not fit in 32 bits");
+            }
+        }
+        if (p == start || (p < end && *p != '\n' && *p != '\r' && *p != ' ' && *p != '\t'))
+        {
+            throw std::runtime_error(std::string(path) + ":" + std::to_string(line) + ": expected a hex word or @address");
+        }
+
+        if (is_address)
+        {
+            current_addr = (uint32_t)value;
+        }
+        else
+        {
+            words.push_back({current_addr, (uint32_t)value});
+            current_addr += 4;
+        }
+    }
+}
+
+}
+
+const ProgramSymbol *ProgramImage::symbol_at(uint32_t address) const
+{
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), address,
+                               [](uint32_t a, const ProgramSymbol &s) { return a < s.address; });
+    const ProgramSymbol *label = nullptr;
+    while (it != symbols.begin())
+    {
+        --it;
+        if (it->size == 0)
+        {
+            if (!label)
+                label = &*it;
+        }
+        else if (address - it->address < it->size)
+        {
+            return &*it;
+        }
+    }
+    return label;
+}
+
+ProgramImage read_program_image(const char *path)
+{
+    mapped_file file(path);
+    const char *p = file.data();
+    const char *end = p + file.size();
+
+    ProgramImage image;
+    size_t magic = strlen(PROGRAM_IMAGE_MAGIC);
+    if (file.size() >= 4 && memcmp(p, ELF_MAGIC, 4) == 0)
+    {
+        parse_elf(path, p, file.size(), image);
+    }
+    else if (file.size() >= magic && memcmp(p, PROGRAM_IMAGE_MAGIC, magic) == 0)
+    {
+        parse_binary(path, p, end, image.words);
+    }
+    else
+    {
+        // every VMH line holds at least 9 bytes per word
+        image.words.reserve(file.size() / 9);
+        parse_vmh(path, p, end, image.words);
+    }
+    return image;
+}
@@ -218,6 +218,64 @@ void ram_write(
 	ram_write(x, 0, x.size(), i, data);
 }
 
+// same as ram_write above, but only the parts of data whose enable bit is
+// set are written: enable has one bit per data.size()/enable.size() bits
+// (one per byte for byte-enables), and the rest of the selected word keeps
+// its old value. This is a read-modify-write in one traversal: the old
+// word is only read at the leaves, by the same mux that writes them.
+void ram_write_masked(
+  vector<std::vector<bit>> &x,
+  bigint L,
+  bigint H,
+  const vector<bit> &i,
+  bigint ibits,
+  const vector<bit> &data,
+  const vector<bit> &enable,
+  bit b, bool top)
+{
+  assert (x.at(0).size() == data.size());
+  assert (!enable.empty() && data.size() % enable.size() == 0);
+
+  if (H <= L) return;
+  if (H == L+1) {
+    bigint group = data.size()/enable.size();
+    for (bigint k = 0;k < enable.size();++k) {
+      bit keep = top ? bit(0) : b.orn(enable.at(k));
+      for (bigint r = k*group;r < (k+1)*group;++r)
+        if (top)
+          x.at(L).at(r) = enable.at(k).mux(x.at(L).at(r), data.at(r));
+        else
+          x.at(L).at(r) = keep.mux(data.at(r), x.at(L).at(r));
+    }
+    return;
+  }
+
+  bigint splitpos = 0;
+  bigint split = 1;
+  while (L+split < H-split) {
+    splitpos += 1;
+    split *= 2;
+  }
+
+  if (ibits <= splitpos) {
+    return ram_write_masked(x,L,L+split,i,ibits,data,enable,b,top);
+  }
+
+  bit isplit = i.at(splitpos);
+
+  ram_write_masked(x,L,L+split,i,splitpos,data,enable, top ?  isplit :  (b | isplit), 0);
+  ram_write_masked(x,L+split,H,i,splitpos,data,enable, top ? ~isplit : b.orn(isplit), 0);
+}
+
+void ram_write_masked(
+  vector<std::vector<bit>> &x,
+  const vector<bit> &i,
+  const vector<bit> &data,
+  const vector<bit> &enable)
+{
+	ram_write_masked(x, 0, x.size(), i, i.size(), data, enable);
+}
+
 const vector<bit> ram_read_write(
   vector<std::vector<bit>> &x,
   bigint L,
@@ -0,0 +1,539 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include "ram.h"
+#include "ram_cost.h"
+
+using namespace std;
+
+// split used by every level of the mux tree over n words (see ram_read):
+// the smallest power of two with n <= split+split, and its log
+static void ram_split(uint64_t n, uint64_t &split, uint64_t &splitpos)
+{
+  splitpos = 0;
+  split = 1;
+  while (split < n-split) {
+    splitpos += 1;
+    split *= 2;
+  }
+}
+
+// number of muxes per output bit of ram_read over n words
+static uint64_t ram_read_muxes(uint64_t n, uint64_t ibits)
+{
+  static thread_local map<pair<uint64_t,uint64_t>,uint64_t> memo;
+
+  if (n <= 1) return 0;
+
+  auto key = make_pair(n,ibits);
+  auto it = memo.find(key);
+  if (it != memo.end()) return it->second;
+
+  uint64_t split, splitpos;
+  ram_split(n,split,splitpos);
+
+  uint64_t result;
+  if (ibits <= splitpos)
+    result = ram_read_muxes(split,ibits);
+  else
+    result = ram_read_muxes(split,splitpos)+ram_read_muxes(n-split,splitpos)+1;
+
+  memo[key] = result;
+  return result;
+}
+
+// ram_write over n words: leaves that mux the data in, plus the or/orn/not
+// gates that route the write-enable down the tree (top: root of the tree)
+struct ram_write_gates {
+  uint64_t leaves = 0;
+  uint64_t ors = 0;
+  uint64_t orns = 0;
+  uint64_t nots = 0;
+};
+
+static ram_write_gates ram_write_tree(uint64_t n, uint64_t ibits, bool top)
+{
+  static thread_local map<pair<pair<uint64_t,uint64_t>,bool>,ram_write_gates> memo;
+
+  ram_write_gates result;
+  if (n == 0) return result;
+  if (n == 1) {
+    if (!top) result.leaves = 1;
+    return result;
+  }
+
+  auto key = make_pair(make_pair(n,ibits),top);
+  auto it = memo.find(key);
+  if (it != memo.end()) return it->second;
+
+  uint64_t split, splitpos;
+  ram_split(n,split,splitpos);
+
+  if (ibits <= splitpos)
+    result = ram_write_tree(split,ibits,top);
+  else {
+    ram_write_gates r0 = ram_write_tree(split,splitpos,0);
+    ram_write_gates r1 = ram_write_tree(n-split,splitpos,0);
+    result.leaves = r0.leaves+r1.leaves;
+    result.ors = r0.ors+r1.ors;
+    result.orns = r0.orns+r1.orns;
+    result.nots = r0.nots+r1.nots;
+    if (top)
+      result.nots += 1; // ~isplit
+    else {
+      result.ors += 1; // b | isplit
+      result.orns += 1; // b.orn(isplit)
+    }
+  }
+
+  memo[key] = result;
+  return result;
+}
+
+static uint64_t ram_address_bits(uint64_t N)
+{
+  uint64_t ibits = 0;
+  while (((uint64_t) 1 << ibits) < N) ibits++;
+  return ibits;
+}
+
+bit_ops_counts ram_read_cost(uint64_t N, uint64_t width, uint64_t ibits)
+{
+  bit_ops_counts c;
+  c[bit_ops_mux] = ram_read_muxes(N,ibits)*width;
+  return c;
+}
+
+bit_ops_counts ram_read_cost(uint64_t N, uint64_t width)
+{
+  return ram_read_cost(N,width,ram_address_bits(N));
+}
+
+bit_ops_counts ram_write_cost(uint64_t N, uint64_t width, uint64_t ibits)
+{
+  ram_write_gates g = ram_write_tree(N,ibits,1);
+  bit_ops_counts c;
+  c[bit_ops_mux] = g.leaves*width;
+  c[bit_ops_or] = g.ors;
+  c[bit_ops_orn] = g.orns;
+  c[bit_ops_not] = g.nots;
+  return c;
+}
+
+bit_ops_counts ram_write_cost(uint64_t N, uint64_t width)
+{
+  return ram_write_cost(N,width,ram_address_bits(N));
+}
+
+bit_ops_counts ram_write_masked_cost(uint64_t N, uint64_t width, uint64_t enables, uint64_t ibits)
+{
+  // as ram_write, plus one orn per enable bit at every leaf; with no leaves
+  // below the root, the root word itself is the one (unconditional) leaf
+  ram_write_gates g = ram_write_tree(N,ibits,1);
+  uint64_t leaves = g.leaves ? g.leaves : (N > 0);
+  bit_ops_counts c;
+  c[bit_ops_mux] = leaves*width;
+  c[bit_ops_or] = g.ors;
+  c[bit_ops_orn] = g.orns+g.leaves*enables;
+  c[bit_ops_not] = g.nots;
+  return c;
+}
+
+bit_ops_counts ram_write_masked_cost(uint64_t N, uint64_t width, uint64_t enables)
+{
+  return ram_write_masked_cost(N,width,enables,ram_address_bits(N));
+}
+
+uint64_t ram_leaf(uint64_t N, uint64_t I, uint64_t ibits)
+{
+  uint64_t L = 0;
+  uint64_t H = N;
+
+  while (H > L+1) {
+    uint64_t split, splitpos;
+    ram_split(H-L,split,splitpos);
+
+    if (ibits <= splitpos) {
+      H = L+split;
+      continue;
+    }
+    if ((I >> splitpos) & 1)
+      L += split;
+    else
+      H = L+split;
+    ibits = splitpos;
+  }
+  return L;
+}
+
+#if ZEROLOOP_DEPTH
+
+// mux levels on the deepest path of ram_read over n words
+static uint64_t ram_read_levels(uint64_t n, uint64_t ibits)
+{
+  static thread_local map<pair<uint64_t,uint64_t>,uint64_t> memo;
+
+  if (n <= 1) return 0;
+
+  auto key = make_pair(n,ibits);
+  auto it = memo.find(key);
+  if (it != memo.end()) return it->second;
+
+  uint64_t split, splitpos;
+  ram_split(n,split,splitpos);
+
+  uint64_t result;
+  if (ibits <= splitpos)
+    result = ram_read_levels(split,ibits);
+  else
+    result = 1+max(ram_read_levels(split,splitpos),ram_read_levels(n-split,splitpos));
+
+  memo[key] = result;
+  return result;
+}
+
+// delay the write-enable of ram_write picks up below a non-top node
+static uint64_t ram_write_enable_delay(uint64_t n, uint64_t ibits)
+{
+  static thread_local map<pair<uint64_t,uint64_t>,uint64_t> memo;
+
+  if (n <= 1) return 0;
+
+  auto key = make_pair(n,ibits);
+  auto it = memo.find(key);
+  if (it != memo.end()) return it->second;
+
+  uint64_t split, splitpos;
+  ram_split(n,split,splitpos);
+
+  uint64_t result;
+  if (ibits <= splitpos)
+    result = ram_write_enable_delay(split,ibits);
+  else
+    result = max(bit::delay[bit_ops_or]+ram_write_enable_delay(split,splitpos),
+                 bit::delay[bit_ops_orn]+ram_write_enable_delay(n-split,splitpos));
+
+  memo[key] = result;
+  return result;
+}
+
+// same from the root: the write-enable at the deepest leaf, relative to the
+// address; false if the root is the only leaf (the word is just replaced)
+static bool ram_write_enable_top(uint64_t n, uint64_t ibits, uint64_t &delay)
+{
+  if (n <= 1) return false;
+
+  uint64_t split, splitpos;
+  ram_split(n,split,splitpos);
+
+  if (ibits <= splitpos) return ram_write_enable_top(split,ibits,delay);
+
+  delay = max(ram_write_enable_delay(split,splitpos),
+              bit::delay[bit_ops_not]+ram_write_enable_delay(n-split,splitpos));
+  return true;
+}
+
+static void ram_depth_max(const vector<bit> &v, uint64_t &c, uint64_t &l)
+{
+  for (const bit &b : v) {
+    c = max(c,b.depth_in_cycle());
+    l = max(l,b.depth_in_local());
+  }
+}
+
+void ram_read_depth(uint64_t N, const vector<bit> &i, bit *word, size_t width)
+{
+  uint64_t ac = 0, al = 0;
+  ram_depth_max(i,ac,al);
+  uint64_t tree = ram_read_levels(N,i.size())*bit::delay[bit_ops_mux];
+  if (tree == 0) return;
+
+  for (size_t r = 0;r < width;++r)
+    word[r].depth_set(max(ac,word[r].depth_in_cycle())+tree,
+                      max(al,word[r].depth_in_local())+tree);
+}
+
+void ram_write_depth(uint64_t N, const vector<bit> &i, const vector<bit> &data,
+                     const vector<bit> *enable, bit *word)
+{
+  uint64_t ac = 0, al = 0, dc = 0, dl = 0, ec = 0, el = 0;
+  ram_depth_max(i,ac,al);
+  ram_depth_max(data,dc,dl);
+  if (enable) ram_depth_max(*enable,ec,el);
+
+  uint64_t below = 0;
+  bool routed = ram_write_enable_top(N,i.size(),below);
+  if (!routed && !enable) return; // plain copy of data
+
+  // select of the leaf mux: the routed write-enable, or'ed with ~enable
+  uint64_t sc, sl;
+  if (!routed) {
+    sc = ec;
+    sl = el;
+  } else {
+    sc = ac+below;
+    sl = al+below;
+    if (enable) {
+      sc = max(sc,ec)+bit::delay[bit_ops_orn];
+      sl = max(sl,el)+bit::delay[bit_ops_orn];
+    }
+  }
+
+  for (size_t r = 0;r < data.size();++r)
+    word[r].depth_set(max(sc,dc)+bit::delay[bit_ops_mux],max(sl,dl)+bit::delay[bit_ops_mux]);
+}
+
+#endif
+
+static bool ram_address_uniform(const vector<bit> &i)
+{
+  for (const bit &b : i)
+    if (!b.uniform()) return false;
+  return true;
+}
+
+static uint64_t ram_address_lane(const vector<bit> &i, size_t lane)
+{
+  uint64_t I = 0;
+  for (size_t j = 0;j < i.size() && j < 64;++j)
+    I |= (uint64_t) i[j].lane(lane) << j;
+  return I;
+}
+
+bool ram_leaves(uint64_t N, const vector<bit> &i, uint64_t leaves[bit_slicing])
+{
+  leaves[0] = ram_leaf(N,ram_address_lane(i,0),i.size());
+  if (ram_address_uniform(i)) return true;
+
+  for (size_t lane = 1;lane < bit_slicing;++lane)
+    leaves[lane] = ram_leaf(N,ram_address_lane(i,lane),i.size());
+  return false;
+}
+
+const vector<bit> ram_read_analytic(
+  const vector<std::vector<bit>> &x,
+  const vector<bit> &i)
+{
+  if (x.empty()) return vector<bit>{};
+
+  uint64_t N = x.size();
+  size_t width = x.at(0).size();
+  bit::count(ram_read_cost(N,width,i.size()));
+
+  uint64_t leaves[bit_slicing];
+  bool uniform = ram_leaves(N,i,leaves);
+  vector<bit> result = x.at(leaves[0]);
+  if (!uniform)
+    for (size_t lane = 1;lane < bit_slicing;++lane)
+      for (size_t r = 0;r < width;++r)
+        result[r].set_lane(lane,x[leaves[lane]][r].lane(lane));
+
+  ram_read_depth(N,i,result.data(),width);
+  return result;
+}
+
+void ram_write_analytic(
+  vector<std::vector<bit>> &x,
+  const vector<bit> &i,
+  const vector<bit> &data)
+{
+  if (x.empty()) return;
+  assert (x.at(0).size() == data.size());
+
+  uint64_t N = x.size();
+  bit::count(ram_write_cost(N,data.size(),i.size()));
+
+  uint64_t leaves[bit_slicing];
+  if (ram_leaves(N,i,leaves)) {
+    x.at(leaves[0]) = data;
+    ram_write_depth(N,i,data,nullptr,x[leaves[0]].data());
+    return;
+  }
+
+  for (size_t lane = 0;lane < bit_slicing;++lane)
+    for (size_t r = 0;r < data.size();++r)
+      x[leaves[lane]][r].set_lane(lane,data[r].lane(lane));
+  for (size_t lane = 0;lane < bit_slicing;++lane)
+    ram_write_depth(N,i,data,nullptr,x[leaves[lane]].data());
+}
+
+void ram_merge_masked(bit *word, const vector<bit> &data, const vector<bit> &enable)
+{
+  size_t group = data.size()/enable.size();
+  bool uniform = true;
+  for (const bit &e : enable)
+    if (!e.uniform()) uniform = false;
+
+  if (uniform) {
+    for (size_t k = 0;k < enable.size();++k)
+      if (enable[k].lane(0))
+        copy(data.begin()+k*group,data.begin()+(k+1)*group,word+k*group);
+    return;
+  }
+
+  for (size_t lane = 0;lane < bit_slicing;++lane)
+    ram_merge_masked(word,data,enable,lane);
+}
+
+void ram_merge_masked(bit *word, const vector<bit> &data, const vector<bit> &enable, size_t lane)
+{
+  size_t group = data.size()/enable.size();
+  for (size_t k = 0;k < enable.size();++k)
+    if (enable[k].lane(lane))
+      for (size_t r = k*group;r < (k+1)*group;++r)
+        word[r].set_lane(lane,data[r].lane(lane));
+}
+
+void ram_write_masked_analytic(
+  vector<std::vector<bit>> &x,
+  const vector<bit> &i,
+  const vector<bit> &data,
+  const vector<bit> &enable)
+{
+  if (x.empty()) return;
+  assert (x.at(0).size() == data.size());
+
+  uint64_t N = x.size();
+  bit::count(ram_write_masked_cost(N,data.size(),enable.size(),i.size()));
+
+  uint64_t leaves[bit_slicing];
+  if (ram_leaves(N,i,leaves)) {
+    ram_merge_masked(x.at(leaves[0]).data(),data,enable);
+    ram_write_depth(N,i,data,&enable,x[leaves[0]].data());
+    return;
+  }
+
+  for (size_t lane = 0;lane < bit_slicing;++lane)
+    ram_merge_masked(x[leaves[lane]].data(),data,enable,lane);
+  for (size_t lane = 0;lane < bit_slicing;++lane)
+    ram_write_depth(N,i,data,&enable,x[leaves[lane]].data());
+}
+
+// random value in every lane
+static bit ram_random_bit(mt19937_64 &rng)
+{
+  bit b;
+  for (size_t lane = 0;lane < bit_slicing;++lane)
+    b.set_lane(lane,rng() & 1);
+  return b;
+}
+
+static void ram_verify_fail(const string &what, uint64_t N, uint64_t width, uint64_t ibits)
+{
+  ostringstream msg;
+  msg << "RAM " << what << " mismatch for " << N << " words of " << width
+      << " bits with " << ibits << " address bits";
+  throw runtime_error(msg.str());
+}
+
+// deepest bit of a set of words, in the current cycle
+static uint64_t ram_depth(const vector<vector<bit>> &x)
+{
+  uint64_t d = 0;
+  for (const auto &word : x)
+    for (const bit &b : word)
+      d = max(d,b.depth_in_cycle());
+  return d;
+}
+
+static bool ram_same(const vector<bit> &a, const vector<bit> &b)
+{
+  if (a.size() != b.size()) return false;
+  for (size_t r = 0;r < a.size();++r)
+    if (a[r].value_vector() != b[r].value_vector()) return false;
+  return true;
+}
+
+void ram_cost_verify(ostream &out)
+{
+  vector<uint64_t> sizes;
+  for (uint64_t N = 1;N <= 40;++N) sizes.push_back(N);
+  for (uint64_t N : {63, 64, 65, 100, 127, 128, 129, 255, 256, 257, 1000})
+    sizes.push_back(N);
+
+  mt19937_64 rng(1);
+  uint64_t checked = 0;
+
+  for (uint64_t N : sizes)
+    for (uint64_t width : {1, 5, 32})
+      for (uint64_t extra = 0;extra <= 1;++extra) {
+        uint64_t ibits = ram_address_bits(N)+extra;
+
+        vector<vector<bit>> x(N,vector<bit>(width));
+        for (auto &word : x)
+          for (auto &b : word)
+            b = ram_random_bit(rng);
+
+        // one address for all lanes, then a different one per lane
+        for (int per_lane = 0;per_lane <= 1;++per_lane) {
+          vector<bit> i(ibits);
+          uint64_t I = rng();
+          for (size_t j = 0;j < ibits;++j)
+            i[j] = per_lane ? ram_random_bit(rng) : bit((I >> j) & 1);
+
+          vector<bit> data(width);
+          for (auto &b : data)
+            b = ram_random_bit(rng);
+
+          // each access in a cycle of its own, so depths start from 0
+          bit::depth_cycle();
+          bit_ops_counts start = bit::counts();
+          vector<bit> circuit = ram_read(x,i);
+          if (memcmp((bit::counts()-start).n,ram_read_cost(N,width,ibits).n,sizeof start.n))
+            ram_verify_fail("read cost",N,width,ibits);
+          uint64_t depth = ram_depth({circuit});
+          bit::depth_cycle();
+          vector<bit> analytic = ram_read_analytic(x,i);
+          if (!ram_same(circuit,analytic))
+            ram_verify_fail("read",N,width,ibits);
+          if (depth != ram_depth({analytic}))
+            ram_verify_fail("read depth",N,width,ibits);
+
+          vector<vector<bit>> y = x;
+          bit::depth_cycle();
+          start = bit::counts();
+          ram_write(x,i,data);
+          if (memcmp((bit::counts()-start).n,ram_write_cost(N,width,ibits).n,sizeof start.n))
+            ram_verify_fail("write cost",N,width,ibits);
+          depth = ram_depth(x);
+          bit::depth_cycle();
+          ram_write_analytic(y,i,data);
+          for (uint64_t w = 0;w < N;++w)
+            if (!ram_same(x[w],y[w]))
+              ram_verify_fail("write",N,width,ibits);
+          if (depth != ram_depth(y))
+            ram_verify_fail("write depth",N,width,ibits);
+
+          // byte-enables for 32-bit words, one enable otherwise; uniform
+          // enables with a uniform address, per-lane ones with per-lane
+          uint64_t enables = width == 32 ? 4 : 1;
+          vector<bit> enable(enables);
+          uint64_t E = rng();
+          for (size_t k = 0;k < enables;++k)
+            enable[k] = per_lane ? ram_random_bit(rng) : bit((E >> k) & 1);
+
+          bit::depth_cycle();
+          start = bit::counts();
+          ram_write_masked(x,i,data,enable);
+          if (memcmp((bit::counts()-start).n,ram_write_masked_cost(N,width,enables,ibits).n,sizeof start.n))
+            ram_verify_fail("masked write cost",N,width,ibits);
+          depth = ram_depth(x);
+          bit::depth_cycle();
+          ram_write_masked_analytic(y,i,data,enable);
+          for (uint64_t w = 0;w < N;++w)
+            if (!ram_same(x[w],y[w]))
+              ram_verify_fail("masked write",N,width,ibits);
+          if (depth != ram_depth(y))
+            ram_verify_fail("masked write depth",N,width,ibits);
+
+          ++checked;
+        }
+      }
+
+  out << "RAM cost formulas match the circuit on " << checked << " configurations" << endl;
+}
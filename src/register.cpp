@@ -1,17 +1,47 @@
 #include "register.h"
 #include "bit_vector.h" // For bit_vector_from_integer function
+#include <algorithm>
+#include <stdexcept>
 
-Register::Register(size_t width) : data(width, bit(0))
+void Register::set_width(size_t width)
+{
+    if (width > REGISTER_MAX_WIDTH)
+    {
+        throw std::length_error("Register wider than REGISTER_MAX_WIDTH");
+    }
+    n = width;
+}
+
+Register::Register(size_t width)
 {
     // Initialize register with specified width, all bits set to 0
+    set_width(width);
+    for (size_t i = 0; i < n; i++)
+    {
+        data[i] = bit(0);
+    }
+}
+
+Register::Register(const Register &other) : n(other.n)
+{
+    std::copy(other.data, other.data + n, data);
+}
+
+Register &Register::operator=(const Register &other)
+{
+    n = other.n;
+    std::copy(other.data, other.data + n, data);
+    return *this;
 }
 
-Register::Register(std::vector<bit> &bits) : data(bits)
+Register::Register(std::vector<bit> &bits)
 {
     // Initialize register with existing bit vector
+    set_width(bits.size());
+    std::copy(bits.begin(), bits.end(), data);
 }
 
-Register::Register(bigint value, size_t width) : data(width, bit(0))
+Register::Register(bigint value, size_t width) : Register(width)
 {
     // Convert integer value to bits and store in register
     std::vector<bit> value_bits = bit_vector_from_integer(value);
@@ -23,38 +53,36 @@ Register::Register(bigint value, size_t width) : data(width, bit(0))
     }
 }
 
-Register::Register(int32_t value, size_t width) : data(width, bit(0))
+Register::Register(int32_t value, size_t width)
 {
-    std::vector<bit> value_bits = bit_vector_from_int32(value);
-    for (size_t i = 0; i < width && i < value_bits.size(); i++)
+    set_width(width);
+    for (size_t i = 0; i < n && i < 32; i++)
     {
-        data[i] = value_bits[i];
+        data[i] = bit((value >> i) & 1);
     }
     // Sign extend if width is greater than 32
-    if (width > 32 && (value < 0))
+    for (size_t i = 32; i < n; i++)
     {
-        for (size_t i = 32; i < width; i++)
-        {
-            data[i] = bit(1);
-        }
+        data[i] = bit(value < 0);
     }
 }
 
-Register::Register(uint32_t value, size_t width) : data(width, bit(0))
+Register::Register(uint32_t value, size_t width)
 {
-    std::vector<bit> value_bits = bit_vector_from_uint64(value);
-    for (size_t i = 0; i < width && i < value_bits.size(); i++)
+    set_width(width);
+    for (size_t i = 0; i < n; i++)
     {
-        data[i] = value_bits[i];
+        data[i] = bit(i < 32 ? (value >> i) & 1 : 0);
     }
 }
 
-Register::Register(unsigned long long value, size_t width) : data(width, bit(0))
+Register::Register(unsigned long long value, size_t width)
 {
-    std::vector<bit> value_bits = bit_vector_from_int32(value);
-    for (size_t i = 0; i < width && i < value_bits.size(); i++)
+    // Only the low 32 bits are taken
+    set_width(width);
+    for (size_t i = 0; i < n; i++)
     {
-        data[i] = value_bits[i];
+        data[i] = bit(i < 32 ? (value >> i) & 1 : 0);
     }
 }
 
@@ -65,7 +93,7 @@ bit Register::get_bit(size_t index) const
 
 size_t Register::width() const
 {
-    return data.size();
+    return n;
 }
 
 void Register::print(const std::string &name) const
@@ -80,30 +108,78 @@ void Register::print(const std::string &name) const
 
 bit &Register::at(size_t index)
 {
-    return data.at(index);
+    if (index >= n)
+    {
+        throw std::out_of_range("Register::at");
+    }
+    return data[index];
 }
 
 const bit &Register::at(size_t index) const
 {
-    return data.at(index);
+    if (index >= n)
+    {
+        throw std::out_of_range("Register::at");
+    }
+    return data[index];
 }
 
 void Register::push_back(const bit &b)
 {
-    data.push_back(b);
+    set_width(n + 1);
+    data[n - 1] = b;
+}
+
+std::vector<bit> Register::get_data() const
+{
+    return std::vector<bit>(data, data + n);
+}
+
+Register Register::operator~() const
+{
+    Register result(*this);
+    bit::word_not(result.data, data, n);
+    return result;
+}
+
+Register Register::operator^(const Register &b) const
+{
+    assert(n == b.n);
+    Register result(*this);
+    bit::word_xor(result.data, data, b.data, n);
+    return result;
+}
+
+Register Register::operator&(const Register &b) const
+{
+    assert(n == b.n);
+    Register result(*this);
+    bit::word_and(result.data, data, b.data, n);
+    return result;
 }
 
-const std::vector<bit> &Register::get_data()
+Register Register::operator|(const Register &b) const
 {
-    return data;
+    assert(n == b.n);
+    Register result(*this);
+    bit::word_or(result.data, data, b.data, n);
+    return result;
+}
+
+Register Register::mux(const bit &select, const Register &if_zero, const Register &if_one)
+{
+    assert(if_zero.n == if_one.n);
+    Register result(if_zero);
+    bit::word_mux(select, result.data, if_zero.data, if_one.data, if_zero.n);
+    return result;
 }
 
 uint32_t Register::get_data_uint() const
 {
-    assert(data.size() <= 32 && "Register size must be 32 bits or less");
+    assert(n <= 32 && "Register size must be 32 bits or less");
 
     uint32_t result = 0;
-    for (size_t i = 0; i < data.size(); i++)
+    for (size_t i = 0; i < n; i++)
     {
         if (data[i].value())
         {
@@ -115,25 +191,25 @@ uint32_t Register::get_data_uint() const
 
 void Register::update_data(bigint new_data)
 {
-    Register new_data_reg(new_data, data.size());
-    for (bigint i = 0; i < data.size(); i++)
+    Register new_data_reg(new_data, n);
+    for (bigint i = 0; i < n; i++)
     {
-        data.at(i) = new_data_reg.at(i);
+        data[i] = new_data_reg.at(i);
     }
 }
 
 std::vector<bit> Register::operator()(size_t start, size_t end) const
 {
-    if (start >= data.size() || end > data.size() || start >= end)
+    if (start >= n || end > n || start >= end)
     {
         throw std::out_of_range("Invalid range");
     }
-    return std::vector<bit>(data.begin() + start, data.begin() + end);
+    return std::vector<bit>(data + start, data + end);
 }
 
 uint32_t Register::operator()(size_t start, size_t end, bool as_uint32_t) const
 {
-    if (start >= data.size() || end > data.size() || start >= end)
+    if (start >= n || end > n || start >= end)
     {
         throw std::out_of_range("Invalid range");
     }
@@ -0,0 +1,194 @@
+#include "run_report.h"
+#include "bit_cost_model.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+static std::string json_string(const std::string &s)
+{
+    std::string r = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            r += '\\';
+        r += c;
+    }
+    return r + "\"";
+}
+
+static std::string csv_field(const std::string &s)
+{
+    if (s.find_first_of(",\"\n") == std::string::npos)
+        return s;
+    std::string r = "\"";
+    for (char c : s)
+    {
+        if (c == '"')
+            r += '"';
+        r += c;
+    }
+    return r + "\"";
+}
+
+// rates are printed with fixed precision so reports diff cleanly
+static std::string fixed(double x)
+{
+    std::ostringstream s;
+    s.setf(std::ios::fixed);
+    s.precision(6);
+    s << x;
+    return s.str();
+}
+
+static void json_gates(std::ostream &out, const bit_ops_counts &counts)
+{
+    out << "{ ";
+    bool first = true;
+    for (const auto &op : bit_ops_selectors)
+    {
+        if (op == bit_ops_cost)
+            continue;
+        out << (first ? "" : ", ") << "\"" << bit::opsname(op) << "\": " << counts[op];
+        first = false;
+    }
+    out << " }";
+}
+
+const char *run_status_name(run_status status)
+{
+    switch (status)
+    {
+    case run_exited: return "exited";
+    case run_instruction_limit: return "instruction_limit";
+    case run_gate_limit: return "gate_limit";
+    case run_timeout: return "timeout";
+    case run_self_loop: return "self_loop";
+    case run_pc_outside_text: return "pc_outside_text";
+    }
+    return "unknown";
+}
+
+void RunReport::write_json(std::ostream &out) const
+{
+    const bit_cost_model &primary = bit_cost_model::primary();
+    double rate = seconds > 0 ? instructions / seconds : 0;
+
+    out << "{\n";
+    out << "  \"program\": " << json_string(program) << ",\n";
+    out << "  \"status\": " << json_string(run_status_name(status)) << ",\n";
+    if (status == run_exited)
+        out << "  \"exit_code\": " << exit_code << ",\n";
+    else
+        out << "  \"exit_code\": null,\n";
+    out << "  \"pc\": " << pc << ",\n";
+    out << "  \"instructions\": " << instructions << ",\n";
+    out << "  \"lanes\": " << lanes << ",\n";
+    out << "  \"gates\": " << primary.cost(gates) << ",\n";
+    out << "  \"cpu_gates\": " << primary.cost(cpu) << ",\n";
+    out << "  \"memory_gates\": " << primary.cost(gates - cpu) << ",\n";
+    out << "  \"gates_by_type\": ";
+    json_gates(out, gates);
+    out << ",\n  \"cpu_gates_by_type\": ";
+    json_gates(out, cpu);
+    out << ",\n";
+
+    out << "  \"cost_models\": [";
+    const std::vector<bit_cost_model> &models = bit_cost_model::selected();
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        out << (i ? "," : "") << "\n    { \"name\": " << json_string(models[i].name)
+            << ", \"gates\": " << models[i].cost(gates)
+            << ", \"cpu_gates\": " << models[i].cost(cpu) << " }";
+    }
+    out << (models.empty() ? "" : "\n  ") << "],\n";
+
+    out << "  \"counters\": [";
+    for (size_t i = 0; i < counters.size(); i++)
+    {
+        const Counter &c = counters[i];
+        out << (i ? "," : "") << "\n    { \"id\": " << c.id
+            << ", \"hits\": " << c.hits
+            << ", \"open\": " << (c.open ? "true" : "false")
+            << ", \"unmatched\": " << c.unmatched
+            << ", \"gates\": " << primary.cost(c.gates)
+            << ", \"cpu_gates\": " << primary.cost(c.cpu)
+            << ", \"gates_by_type\": ";
+        json_gates(out, c.gates);
+        out << " }";
+    }
+    out << (counters.empty() ? "" : "\n  ") << "],\n";
+
+    out << "  \"wall_seconds\": " << fixed(seconds) << ",\n";
+    out << "  \"instructions_per_second\": " << fixed(rate) << "\n";
+    out << "}\n";
+}
+
+void RunReport::write_csv(std::ostream &out, bool with_header) const
+{
+    const bit_cost_model &primary = bit_cost_model::primary();
+    double rate = seconds > 0 ? instructions / seconds : 0;
+    std::ostringstream header, row;
+
+    header << "program,status,exit_code,pc,instructions,lanes,gates,cpu_gates,memory_gates";
+    row << csv_field(program) << "," << run_status_name(status) << ","
+        << (status == run_exited ? std::to_string(exit_code) : "") << "," << pc << "," << instructions << "," << lanes << ","
+        << primary.cost(gates) << "," << primary.cost(cpu) << "," << primary.cost(gates - cpu);
+    for (const auto &op : bit_ops_selectors)
+    {
+        if (op == bit_ops_cost)
+            continue;
+        header << "," << bit::opsname(op);
+        row << "," << gates[op];
+    }
+    for (const Counter &c : counters)
+    {
+        std::string name = "counter" + std::to_string(c.id);
+        header << "," << name << "_hits," << name << "_gates," << name << "_cpu_gates";
+        row << "," << c.hits << "," << primary.cost(c.gates) << "," << primary.cost(c.cpu);
+    }
+    header << ",wall_seconds,instructions_per_second";
+    row << "," << fixed(seconds) << "," << fixed(rate);
+
+    if (with_header)
+        out << header.str() << "\n";
+    out << row.str() << "\n";
+}
+
+void RunReport::save(report_format format, const std::string &path, bool append) const
+{
+    if (format == report_csv && append)
+    {
+        std::ifstream in(path);
+        std::string existing;
+        if (std::getline(in, existing))
+        {
+            std::ostringstream mine;
+            write_csv(mine);
+            if (existing != mine.str().substr(0, mine.str().find('\n')))
+                throw std::runtime_error("Could not append to report " + path + ": its columns are not this run's");
+
+            // a row of its own even if the file does not end in a newline
+            in.clear();
+            in.seekg(-1, std::ios::end);
+            bool newline = in.get() == '\n';
+            std::ofstream out(path, std::ios::app);
+            if (!out.is_open())
+                throw std::runtime_error("Could not write report " + path);
+            if (!newline)
+                out << "\n";
+            write_csv(out, false);
+            return;
+        }
+    }
+
+    std::ofstream out(path);
+    if (!out.is_open())
+    {
+        throw std::runtime_error("Could not write report " + path);
+    }
+    if (format == report_json)
+        write_json(out);
+    else
+        write_csv(out);
+}
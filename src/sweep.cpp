@@ -0,0 +1,632 @@
+#include "sweep.h"
+#include "bit_cost_model.h"
+#include "console.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// One point of the cross product
+struct SweepPoint
+{
+    std::string image;
+    size_t instr_mem_words;
+    size_t data_mem_words;
+    bool ram_accurate;
+    bool with_decoder;
+    ram_backend ram;
+    std::string plugins; // --plugin units joined by '+', empty for the linked-in unit
+    plugin_idle_cost plugin_idle;
+    std::string key; // of the run, shared by points that run the same thing
+};
+
+// What a run left, as kept in the .runs file
+struct SweepRun
+{
+    run_status status = run_exited;
+    int exit_code = 0;
+    uint32_t pc = 0;
+    uint64_t instructions = 0;
+    double seconds = 0;
+    bit_ops_counts gates;
+    bit_ops_counts cpu;
+};
+
+struct SweepSpec
+{
+    std::vector<std::string> images;
+    std::vector<std::string> cost_models;
+    std::vector<size_t> instr_mem_sizes;
+    std::vector<size_t> data_mem_sizes;
+    std::vector<bool> ram_accurate;
+    std::vector<bool> decoder;
+    std::vector<ram_backend> rams;
+    std::vector<std::string> plugins;
+    std::vector<plugin_idle_cost> plugin_idles;
+    uint64_t max_instructions;
+    uint64_t max_gates;
+    double timeout;
+    std::string results;
+};
+
+const run_status RUN_STATUSES[] = {run_exited, run_instruction_limit, run_gate_limit,
+                                   run_timeout, run_self_loop, run_pc_outside_text};
+
+std::string csv_field(const std::string &s)
+{
+    if (s.find_first_of(",\"\n") == std::string::npos)
+        return s;
+    std::string r = "\"";
+    for (char c : s)
+    {
+        if (c == '"')
+            r += '"';
+        r += c;
+    }
+    return r + "\"";
+}
+
+const char *ram_name(ram_backend ram)
+{
+    return ram == ram_circuit ? "circuit" : "analytic";
+}
+
+// 64-bit FNV-1a, continued from h
+uint64_t fnv1a(const char *data, size_t size, uint64_t h = 0xcbf29ce484222325ull)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= (unsigned char)data[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+uint64_t file_hash(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Could not open program image " + path);
+    }
+    std::ostringstream bytes;
+    bytes << file.rdbuf();
+    std::string contents = bytes.str();
+    return fnv1a(contents.data(), contents.size());
+}
+
+// What the results of a run depend on beyond its settings: the emulator
+// binary itself (its linked-in plug-in unit, its ALU, ...) and its build
+// configuration
+std::string emulator_key(void)
+{
+    std::ostringstream key;
+    key << "emulator=" << std::hex << file_hash("/proc/self/exe") << std::dec << ";lanes=" << ZEROLOOP_LANES
+        << ";scopes=" << ZEROLOOP_GATE_SCOPES << ";depth=" << ZEROLOOP_DEPTH << ";netlist=" << ZEROLOOP_NETLIST;
+    return key.str();
+}
+
+// --max-gates stops a run under the primary model, so its outcome depends
+// on the weights of that model
+std::string gate_bound_key(uint64_t max_gates)
+{
+    std::ostringstream key;
+    key << "max_gates=" << max_gates;
+    if (max_gates)
+    {
+        const bit_cost_model &primary = bit_cost_model::primary();
+        key << " under " << primary.name;
+        for (const auto &t : bit_ops_selectors)
+        {
+            if (t != bit_ops_cost)
+                key << "," << bit::opsname(t) << "=" << primary.weight[t];
+        }
+    }
+    return key.str();
+}
+
+std::vector<std::string> split_plugins(const std::string &variant)
+{
+    std::vector<std::string> units;
+    std::istringstream in(variant);
+    std::string unit;
+    while (std::getline(in, unit, '+'))
+        units.push_back(unit);
+    return units;
+}
+
+std::string strip_extension(const std::string &path)
+{
+    return (fs::path(path).parent_path() / fs::path(path).stem()).string();
+}
+
+SweepSpec read_spec(const std::string &path, const RunOptions &options)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Could not open sweep spec " + path);
+    }
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+    SweepSpec spec;
+    spec.max_instructions = options.max_instructions;
+    spec.max_gates = options.max_gates;
+    spec.timeout = options.timeout;
+    spec.results = strip_extension(path) + ".csv";
+
+    std::set<std::string> seen;
+    std::string line;
+    size_t lineno = 0;
+    while (std::getline(file, line))
+    {
+        ++lineno;
+        line = line.substr(0, line.find('#'));
+        std::istringstream in(line);
+        std::string key, value;
+        if (!(in >> key))
+            continue;
+        std::string where = path + ":" + std::to_string(lineno) + ": ";
+        std::vector<std::string> values;
+        while (in >> value)
+            values.push_back(value);
+        if (values.empty())
+            throw std::runtime_error(where + "missing value for " + key);
+        bool again = !seen.insert(key).second;
+
+        auto relative = [&](const std::string &p) { return p[0] == '/' ? p : dir + p; };
+        auto count = [&](const std::string &v)
+        {
+            size_t end = 0;
+            unsigned long long n = 0;
+            try { n = std::stoull(v, &end, 0); } catch (const std::exception &) { end = 0; }
+            if (end != v.size())
+                throw std::runtime_error(where + "bad number " + v);
+            return (uint64_t)n;
+        };
+        auto flag = [&](const std::string &v)
+        {
+            if (v != "true" && v != "false")
+                throw std::runtime_error(where + "expected true or false, not " + v);
+            return v == "true";
+        };
+        auto single = [&]()
+        {
+            if (values.size() != 1 || again)
+                throw std::runtime_error(where + key + " takes one value");
+            return values[0];
+        };
+
+        if (key == "image")
+        {
+            for (const auto &v : values)
+            {
+                if (fs::is_directory(relative(v)))
+                {
+                    for (const auto &image : batch_images(relative(v)))
+                        spec.images.push_back(image);
+                }
+                else
+                    spec.images.push_back(relative(v));
+            }
+        }
+        else if (key == "cost-model")
+        {
+            for (const auto &v : values)
+                spec.cost_models.push_back(relative(v));
+        }
+        else if (key == "instr-mem-size")
+        {
+            for (const auto &v : values)
+                spec.instr_mem_sizes.push_back(count(v));
+        }
+        else if (key == "data-mem-size")
+        {
+            for (const auto &v : values)
+                spec.data_mem_sizes.push_back(count(v));
+        }
+        else if (key == "ram-accurate")
+        {
+            for (const auto &v : values)
+                spec.ram_accurate.push_back(flag(v));
+        }
+        else if (key == "decoder")
+        {
+            for (const auto &v : values)
+                spec.decoder.push_back(flag(v));
+        }
+        else if (key == "ram")
+        {
+            for (const auto &v : values)
+            {
+                if (v != "analytic" && v != "circuit")
+                    throw std::runtime_error(where + "expected analytic or circuit, not " + v);
+                spec.rams.push_back(v == "circuit" ? ram_circuit : ram_analytic);
+            }
+        }
+        else if (key == "plugin")
+        {
+            // "none", or units joined by '+' as in a.so+b.so:64-127
+            for (const auto &v : values)
+            {
+                std::string variant;
+                std::istringstream units(v == "none" ? "" : v);
+                std::string unit;
+                while (std::getline(units, unit, '+'))
+                {
+                    std::string file = plugin_unit_path(unit);
+                    variant += (variant.empty() ? "" : "+") + relative(file) + unit.substr(file.size());
+                }
+                spec.plugins.push_back(variant);
+            }
+        }
+        else if (key == "plugin-idle")
+        {
+            for (const auto &v : values)
+            {
+                try
+                {
+                    spec.plugin_idles.push_back(parse_plugin_idle(v));
+                }
+                catch (const std::exception &e)
+                {
+                    throw std::runtime_error(where + e.what());
+                }
+            }
+        }
+        else if (key == "max-instructions")
+            spec.max_instructions = count(single());
+        else if (key == "max-gates")
+            spec.max_gates = count(single());
+        else if (key == "timeout")
+            spec.timeout = std::strtod(single().c_str(), nullptr);
+        else if (key == "results")
+            spec.results = relative(single());
+        else
+            throw std::runtime_error(where + "unknown key " + key);
+    }
+
+    if (spec.images.empty())
+        throw std::runtime_error(path + ": no image to sweep over");
+    if (spec.instr_mem_sizes.empty())
+        spec.instr_mem_sizes.push_back(options.instr_mem_words);
+    if (spec.data_mem_sizes.empty())
+        spec.data_mem_sizes.push_back(options.data_mem_words);
+    if (spec.ram_accurate.empty())
+        spec.ram_accurate.push_back(false);
+    if (spec.decoder.empty())
+        spec.decoder.push_back(true);
+    if (spec.rams.empty())
+        spec.rams.push_back(options.ram);
+    if (spec.plugins.empty())
+    {
+        std::string variant;
+        for (const auto &unit : options.plugins)
+            variant += (variant.empty() ? "" : "+") + unit;
+        spec.plugins.push_back(variant);
+    }
+    if (spec.plugin_idles.empty())
+        spec.plugin_idles.push_back(options.plugin_idle);
+    return spec;
+}
+
+std::string runs_header(void)
+{
+    std::string header = "key,status,exit_code,pc,instructions,seconds";
+    for (const char *prefix : {"", "cpu_"})
+    {
+        for (const auto &t : bit_ops_selectors)
+        {
+            if (t != bit_ops_cost)
+                header += std::string(",") + prefix + bit::opsname(t);
+        }
+    }
+    return header;
+}
+
+std::string runs_line(const std::string &key, const SweepRun &run)
+{
+    std::ostringstream line;
+    line << key << "," << run_status_name(run.status) << "," << run.exit_code << "," << run.pc << ","
+         << run.instructions << "," << std::fixed << std::setprecision(6) << run.seconds;
+    for (const bit_ops_counts *counts : {&run.gates, &run.cpu})
+    {
+        for (const auto &t : bit_ops_selectors)
+        {
+            if (t != bit_ops_cost)
+                line << "," << (*counts)[t];
+        }
+    }
+    return line.str();
+}
+
+// The runs of an earlier sweep, by key. A line cut short by an interrupted
+// write does not parse and is run again.
+std::map<std::string, SweepRun> read_runs(const std::string &path)
+{
+    std::map<std::string, SweepRun> runs;
+    std::ifstream file(path);
+    if (!file.is_open())
+        return runs;
+
+    std::string line;
+    if (!std::getline(file, line))
+        return runs;
+    if (line != runs_header())
+    {
+        throw std::runtime_error(path + " was written by a different build; remove it to run the sweep again");
+    }
+
+    size_t fields = 6 + 2 * (bit_ops_count - 1);
+    while (std::getline(file, line))
+    {
+        std::vector<std::string> f;
+        std::istringstream in(line);
+        std::string field;
+        while (std::getline(in, field, ','))
+            f.push_back(field);
+        if (f.size() != fields)
+            continue;
+
+        SweepRun run;
+        bool known = false;
+        for (run_status s : RUN_STATUSES)
+        {
+            if (f[1] == run_status_name(s))
+            {
+                run.status = s;
+                known = true;
+            }
+        }
+        if (!known)
+            continue;
+        try
+        {
+            run.exit_code = std::stoi(f[2]);
+            run.pc = std::stoul(f[3]);
+            run.instructions = std::stoull(f[4]);
+            run.seconds = std::stod(f[5]);
+            size_t i = 6;
+            for (bit_ops_counts *counts : {&run.gates, &run.cpu})
+            {
+                for (const auto &t : bit_ops_selectors)
+                {
+                    if (t != bit_ops_cost)
+                        (*counts)[t] = std::stoull(f[i++]);
+                }
+            }
+        }
+        catch (const std::exception &)
+        {
+            continue;
+        }
+        runs[f[0]] = run;
+    }
+    return runs;
+}
+
+}
+
+int run_sweep(const std::string &spec_path, const RunOptions &options, const BatchOptions &batch)
+{
+    SweepSpec spec = read_spec(spec_path, options);
+
+    std::vector<bit_cost_model> models;
+    for (const auto &path : spec.cost_models)
+        models.push_back(bit_cost_model::from_file(path));
+    if (models.empty())
+        models = bit_cost_model::selected();
+    if (models.empty())
+        models.push_back(bit_cost_model::primary());
+
+    if (options.verify_ram_cost)
+    {
+        ram_cost_verify(std::cout);
+    }
+
+    // The cross product, keyed by what decides the outcome of a run
+    std::string emulator = emulator_key();
+    std::string gate_bound = gate_bound_key(spec.max_gates);
+    std::map<std::string, uint64_t> image_hashes;
+    std::map<std::string, std::string> plugin_keys; // units with the hashes of their files
+    for (const auto &variant : spec.plugins)
+    {
+        std::ostringstream units;
+        for (const auto &unit : split_plugins(variant))
+            units << unit << "@" << std::hex << file_hash(plugin_unit_path(unit)) << std::dec << ";";
+        plugin_keys[variant] = units.str();
+    }
+    std::vector<SweepPoint> points;
+    for (const auto &image : spec.images)
+    {
+        if (!image_hashes.count(image))
+            image_hashes[image] = file_hash(image);
+        for (size_t instr_words : spec.instr_mem_sizes)
+            for (size_t data_words : spec.data_mem_sizes)
+                for (bool accurate : spec.ram_accurate)
+                    for (bool decoder : spec.decoder)
+                        for (ram_backend ram : spec.rams)
+                            for (const auto &plugins : spec.plugins)
+                                for (const auto &idle : spec.plugin_idles)
+                                {
+                                    SweepPoint point{image, instr_words, data_words, accurate, decoder, ram, plugins, idle, ""};
+                                    std::ostringstream params;
+                                    params << emulator << ";instr_mem_size=" << instr_words << ";data_mem_size=" << data_words
+                                           << ";ram_accurate=" << accurate << ";decoder=" << decoder
+                                           << ";ram=" << ram_name(ram) << ";plugins=" << plugin_keys[plugins]
+                                           << ";plugin_idle=" << plugin_idle_name(idle)
+                                           << ";max_instructions=" << spec.max_instructions
+                                           << ";" << gate_bound << ";timeout=" << spec.timeout;
+                                    std::string p = params.str();
+                                    std::ostringstream key;
+                                    key << std::hex << std::setw(16) << std::setfill('0')
+                                        << fnv1a(p.data(), p.size(), image_hashes[image]);
+                                    point.key = key.str();
+                                    points.push_back(point);
+                                }
+    }
+
+    std::string base = strip_extension(spec.results);
+    std::string runs_path = base + ".runs";
+    std::string logs_dir = base + "_logs";
+    std::map<std::string, SweepRun> runs = read_runs(runs_path);
+
+    // one job per key that has no run yet
+    std::vector<size_t> jobs;
+    std::set<std::string> keys, queued;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        keys.insert(points[i].key);
+        if (!runs.count(points[i].key) && queued.insert(points[i].key).second)
+            jobs.push_back(i);
+    }
+
+    fs::create_directories(logs_dir);
+    bool fresh = !fs::exists(runs_path) || fs::file_size(runs_path) == 0;
+    bool torn = false; // the last line was cut short, so end it first
+    if (!fresh)
+    {
+        std::ifstream last(runs_path, std::ios::binary);
+        last.seekg(-1, std::ios::end);
+        torn = last.get() != '\n';
+    }
+    std::ofstream runs_file(runs_path, std::ios::app);
+    if (!runs_file.is_open())
+    {
+        throw std::runtime_error("Could not write " + runs_path);
+    }
+    if (fresh)
+        runs_file << runs_header() << std::endl;
+    else if (torn)
+        runs_file << std::endl;
+
+    size_t workers = batch_workers(batch.jobs, jobs.size());
+    std::cout << "Sweeping " << points.size() << " points, " << keys.size() << " distinct runs, "
+              << keys.size() - jobs.size() << " done before; running " << jobs.size() << " on " << workers
+              << " threads, logs in " << logs_dir << "/" << std::endl;
+
+    std::map<std::string, std::string> errors;
+    std::mutex lock;
+    size_t finished = 0;
+
+    run_jobs(jobs.size(), workers, [&](size_t job)
+    {
+        const SweepPoint &point = points[jobs[job]];
+
+        RunOptions run = options;
+        run.simt_images.clear();
+        run.ram = point.ram;
+        run.plugins = split_plugins(point.plugins);
+        run.plugin_idle = point.plugin_idle;
+        run.verify_ram_cost = false;
+        run.netlist = netlist_off;
+        run.report = report_none;
+        run.profile_out.clear();
+        run.annotate_out.clear();
+        run.instr_mem_words = point.instr_mem_words;
+        run.data_mem_words = point.data_mem_words;
+        run.max_instructions = spec.max_instructions;
+        run.max_gates = spec.max_gates;
+        run.timeout = spec.timeout;
+
+        sim_context context;
+        sim_context::scope counting(context);
+        std::ofstream log(logs_dir + "/" + point.key + ".log");
+        set_console(&log);
+        SweepRun result;
+        std::string error;
+        try
+        {
+            RunReport report = run_full_system(point.image.c_str(), point.ram_accurate, point.with_decoder, run);
+            result.status = report.status;
+            result.exit_code = report.exit_code;
+            result.pc = report.pc;
+            result.instructions = report.instructions;
+            result.seconds = report.seconds;
+            result.gates = report.gates;
+            result.cpu = report.cpu;
+        }
+        catch (const std::exception &e)
+        {
+            error = e.what();
+            log << "Error: " << e.what() << "\n";
+        }
+        set_console(nullptr);
+
+        // every finished run is on disk before the next one is reported,
+        // so an interrupted sweep loses at most the runs in flight
+        std::lock_guard<std::mutex> guard(lock);
+        finished++;
+        std::cout << "[" << finished << "/" << jobs.size() << "] " << point.key << " " << point.image
+                  << " instr " << point.instr_mem_words << " data " << point.data_mem_words
+                  << (point.ram_accurate ? " accurate" : "") << (point.with_decoder ? "" : " no-decoder")
+                  << " " << ram_name(point.ram) << (point.plugins.empty() ? "" : " " + point.plugins)
+                  << " idle " << plugin_idle_name(point.plugin_idle) << ": ";
+        if (!error.empty())
+        {
+            errors[point.key] = error;
+            std::cout << "error: " << error << std::endl;
+            return;
+        }
+        runs[point.key] = result;
+        runs_file << runs_line(point.key, result) << std::endl;
+        std::cout << run_status_name(result.status) << ", " << models[0].cost(result.gates) << " gates" << std::endl;
+    });
+
+    std::ofstream csv(spec.results);
+    if (!csv.is_open())
+    {
+        throw std::runtime_error("Could not write " + spec.results);
+    }
+    csv << "image,instr_mem_size,data_mem_size,ram_accurate,decoder,ram,plugin,plugin_idle,key,status,exit_code,pc,instructions,seconds";
+    for (const auto &m : models)
+        csv << "," << csv_field(m.name + "_gates") << "," << csv_field(m.name + "_cpu_gates");
+    for (const auto &t : bit_ops_selectors)
+    {
+        if (t != bit_ops_cost)
+            csv << "," << bit::opsname(t);
+    }
+    csv << "\n";
+
+    for (const auto &point : points)
+    {
+        csv << csv_field(point.image) << "," << point.instr_mem_words << "," << point.data_mem_words << ","
+            << (point.ram_accurate ? "true" : "false") << "," << (point.with_decoder ? "true" : "false") << ","
+            << ram_name(point.ram) << "," << csv_field(point.plugins) << ","
+            << csv_field(plugin_idle_name(point.plugin_idle)) << "," << point.key << ",";
+        auto found = runs.find(point.key);
+        if (found == runs.end())
+        {
+            csv << "error" << std::string(4 + 2 * models.size() + bit_ops_count - 1, ',') << "\n";
+            continue;
+        }
+        const SweepRun &r = found->second;
+        csv << run_status_name(r.status) << "," << (r.status == run_exited ? std::to_string(r.exit_code) : "") << ","
+            << r.pc << "," << r.instructions << "," << std::fixed << std::setprecision(6) << r.seconds << std::defaultfloat;
+        for (const auto &m : models)
+            csv << "," << m.cost(r.gates) << "," << m.cost(r.cpu);
+        for (const auto &t : bit_ops_selectors)
+        {
+            if (t != bit_ops_cost)
+                csv << "," << r.gates[t];
+        }
+        csv << "\n";
+    }
+
+    std::cout << "Wrote " << points.size() << " rows to " << spec.results;
+    if (!errors.empty())
+        std::cout << ", " << errors.size() << " runs failed (see their logs)";
+    std::cout << std::endl;
+    return errors.empty() ? 0 : 1;
+}
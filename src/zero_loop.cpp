@@ -1,21 +1,43 @@
 #include "zero_loop.h"
+#include "gate_scope.h"
 #include <stdlib.h>
 #include <iomanip>
 
 void ZeroLoop::print_details()
 {
 
-    std::cout << "\nTotal Gate Count :" << bit::ops() << " gates" << std::endl;
+    console() << "\nTotal Gate Count :" << bit::ops() << " gates" << std::endl;
 
-    std::cout << "\nDetailed Gate Count Breakdown:\n";
-    std::cout << "-----------------------------\n";
+    console() << "\nDetailed Gate Count Breakdown:\n";
+    console() << "-----------------------------\n";
     for (const auto &op : bit_ops_selectors)
     {
         if (op == bit_ops_cost)
             continue; // Skip the total cost, already printed
-        std::cout << std::setw(10) << std::left << bit::opsname(op) << ": "
+        console() << std::setw(10) << std::left << bit::opsname(op) << ": "
                   << bit::ops(op) << " gates\n";
     }
+
+    // Same counts weighted by every model given with --cost-model
+    const std::vector<bit_cost_model> &models = bit_cost_model::selected();
+    if (!models.empty())
+    {
+        console() << "\nGate Count Per Cost Model:\n";
+        console() << "-----------------------------\n";
+        console() << std::setw(16) << std::left << "model"
+                  << std::setw(20) << std::left << "total"
+                  << "cpu only\n";
+        for (const auto &model : models)
+        {
+            console() << std::setw(16) << std::left << model.name
+                      << std::setw(20) << std::left << model.cost()
+                      << model.cost(total_cpu_gate_count) << "\n";
+        }
+    }
+
+    print_counters();
+    gate_scope_report(console());
+    depth_report(console(), simt_lanes);
 }
 
 // Start = 0, End = 1
@@ -24,26 +46,166 @@ void ZeroLoop::print_details()
 // We put end the the start of ZeroLoop delcation so it... (same idea).
 void ZeroLoop::check_for_counter(uint32_t instr, bool start_or_end)
 {
-    // CUSTOM1 0x2B
+    // CUSTOM1 0x2B, counter id in the immediate
     uint32_t opcode = (instr & 0x7F);
     uint32_t funct3 = ((instr >> 12) & 0x7);
+    uint32_t id = instr >> 20;
     if (opcode == 0x2B) // CUSTOM1
     {
         if (funct3 == 0 && !start_or_end)
         {
-            std::cout << "\nCOUNTER0 START" << std::endl;
-            start_count1 = bit::ops();
-            start_count_only_cpu_1 = total_cpu_gate_count;
+            Counter &counter = counters[id];
+            counter.hits += 1;
+            if (counter.open++ == 0)
+            {
+                counter.start = bit::counts();
+                counter.start_cpu = total_cpu_gate_count;
+                if (id == 0 && netlist_target == netlist_counter)
+                {
+                    netlist_recorder::begin();
+                }
+            }
         }
         else if (funct3 == 1 && start_or_end)
         {
-            end_count1 = bit::ops();
-            end_count_only_cpu_1 = total_cpu_gate_count;
-            std::cout << "\nCOUNTER0 END" << std::endl;
-            std::cout << "TOTAL COUNT OF COUNT0 : " << (end_count1 - start_count1) << " GATES " << std::endl;
-            std::cout << "TOTAL COUNT OF COUNT0 (ONLY CPU) : " << (end_count_only_cpu_1 - start_count_only_cpu_1) << " GATES " << std::endl;
+            Counter &counter = counters[id];
+            if (counter.open == 0)
+            {
+                counter.unmatched += 1;
+            }
+            else if (--counter.open == 0)
+            {
+                counter.total += bit::counts() - counter.start;
+                counter.total_cpu += total_cpu_gate_count - counter.start_cpu;
+                if (id == 0 && netlist_target == netlist_counter && netlist_recording())
+                {
+                    save_netlist(netlist_recorder::end(), "counter0");
+                }
+            }
+        }
+    }
+}
+
+// One row per counter id; a counter still active at exit is reported up to
+// now and marked as open
+void ZeroLoop::print_counters()
+{
+    if (counters.empty())
+        return;
+
+    const bit_cost_model &model = bit_cost_model::primary();
+    console() << "\nCounters:\n";
+    console() << "-----------------------------\n";
+    console() << std::setw(9) << std::left << "counter"
+              << std::setw(8) << std::left << "hits"
+              << std::setw(16) << std::left << "gates"
+              << std::setw(16) << std::left << "cpu only";
+    for (const auto &op : bit_ops_selectors)
+    {
+        if (op != bit_ops_cost)
+            console() << std::setw(12) << std::left << bit::opsname(op);
+    }
+    console() << "\n";
+
+    for (const auto &entry : counters)
+    {
+        const Counter &counter = entry.second;
+        bit_ops_counts total = counter.total;
+        bit_ops_counts total_cpu = counter.total_cpu;
+        if (counter.open)
+        {
+            total += bit::counts() - counter.start;
+            total_cpu += total_cpu_gate_count - counter.start_cpu;
+        }
 
+        console() << std::setw(9) << std::left << entry.first
+                  << std::setw(8) << std::left << counter.hits
+                  << std::setw(16) << std::left << model.cost(total)
+                  << std::setw(16) << std::left << model.cost(total_cpu);
+        for (const auto &op : bit_ops_selectors)
+        {
+            if (op != bit_ops_cost)
+                console() << std::setw(12) << std::left << total[op];
         }
+        if (counter.open)
+            console() << "(open)";
+        if (counter.unmatched)
+            console() << "(" << counter.unmatched << " unmatched DEACTIVATE_COUNTER)";
+        console() << "\n";
+    }
+}
+
+RunReport ZeroLoop::save_report(run_status status, int exit_code)
+{
+    RunReport r;
+    r.program = program_name;
+    r.status = status;
+    r.exit_code = exit_code;
+    r.pc = get_pc() * 4;
+    r.instructions = retired;
+    if (status == run_exited)
+        r.instructions += 1; // the exiting ecall does not reach commit
+    r.lanes = simt_lanes;
+    r.gates = bit::counts();
+    r.cpu = total_cpu_gate_count;
+    for (const auto &entry : counters)
+    {
+        const Counter &counter = entry.second;
+        RunReport::Counter c = { entry.first, counter.hits, counter.unmatched, counter.open > 0, counter.total, counter.total_cpu };
+        if (counter.open)
+        {
+            c.gates += bit::counts() - counter.start;
+            c.cpu += total_cpu_gate_count - counter.start_cpu;
+        }
+        r.counters.push_back(c);
+    }
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (report != report_none)
+    {
+        r.save(report, report_path, report_append);
+        console() << "Wrote report " << report_path << std::endl;
+    }
+    return r;
+}
+
+void ZeroLoop::profile_begin()
+{
+    if (!profiler)
+        return;
+    profile_start.pc = get_pc() * 4;
+    profile_start.gates = bit::counts();
+    profile_start.cpu = total_cpu_gate_count;
+    profile_start.plugin = plugin_gate_count;
+}
+
+void ZeroLoop::profile_end(uint32_t instruction)
+{
+    if (!profiler)
+        return;
+    bit_ops_counts cpu = total_cpu_gate_count - profile_start.cpu;
+    bit_ops_counts memory = bit::counts() - profile_start.gates - cpu;
+    profiler->retire(profile_start.pc, instruction, get_pc() * 4, cpu, memory, plugin_gate_count - profile_start.plugin);
+}
+
+void ZeroLoop::save_profile()
+{
+    if (!profiler)
+        return;
+
+    if (!profile_out.empty())
+    {
+        profiler->save(profile_out);
+        profiler->write_top(console(), profile_top);
+        console() << "Wrote profile " << profile_out << ".folded and " << profile_out << ".instructions.folded" << std::endl;
+    }
+    if (annotate_out == "-")
+    {
+        profiler->write_annotated(console());
+    }
+    else if (!annotate_out.empty())
+    {
+        profiler->save_annotated(annotate_out);
+        console() << "Wrote annotated disassembly " << annotate_out << std::endl;
     }
 }
 
@@ -62,17 +224,91 @@ void ZeroLoop::print_registers()
     reg_file.print_all_contents();
 }
 
-Register ZeroLoop::execute_alu(Register &a, Register &b, std::vector<bit> alu_op)
+Register ZeroLoop::execute_alu(Register &a, Register &b, const std::vector<bit> &alu_op)
 {
     return alu.execute(a, b, alu_op);
 }
 
 Register ZeroLoop::execute_plug_in_unit(Register &ret, Register a, Register b, uint32_t funct3, uint32_t funct7, uint32_t opcode)
 {
-    return plugin.execute_plug_in_unit(ret, a, b, funct3, funct7, opcode);
+    // the same node as the idle charge, whichever unit computes
+    GATE_SCOPE("plugin");
+    bit_ops_counts start = bit::counts();
+    Register result(ret.width());
+
+    // A loaded unit bound to this funct7, else the linked-in one
+    const plugin_unit *unit = nullptr;
+    for (const auto &u : plugin_units)
+    {
+        if (funct7 >= u.funct7_first && funct7 <= u.funct7_last)
+            unit = &u;
+    }
+    auto execute = [&]()
+    {
+        if (unit)
+            return unit->info->execute(ret, a, b, funct3, funct7, opcode);
+        return plugin.execute_plug_in_unit(ret, a, b, funct3, funct7, opcode);
+    };
+
+    // Under --plugin-idle=evaluate the decoder path runs the units for every
+    // instruction; record the first one that actually is a custom-0 instruction
+    if (netlist_target != netlist_plugin || opcode != 0x0B)
+    {
+        result = execute();
+    }
+    else
+    {
+        netlist_recorder::begin();
+        netlist_recorder::input("a", &a.at(0), a.width());
+        netlist_recorder::input("b", &b.at(0), b.width());
+        result = execute();
+        netlist_recorder::output("y", &result.at(0), result.width());
+        save_netlist(netlist_recorder::end(), "plugin");
+    }
+
+    bit_ops_counts gates = bit::counts() - start;
+    plugin_gate_count += gates;
+    if (opcode == 0x0B)
+        plugin_last = gates;
+    return result;
+}
+
+void ZeroLoop::charge_idle_plug_in_unit()
+{
+    if (plugin_idle.policy == plugin_idle_zero)
+        return;
+
+    GATE_SCOPE("plugin");
+    const bit_ops_counts &gates = plugin_idle.policy == plugin_idle_static ? plugin_idle.gates : plugin_last;
+    for (const auto &t : bit_ops_selectors)
+    {
+        if (t != bit_ops_cost && gates[t])
+            bit::count(t, gates[t]);
+    }
+    plugin_gate_count += gates;
+}
+
+void ZeroLoop::save_netlist(const netlist &n, const char *model)
+{
+    netlist_target = netlist_off;
+    n.save(netlist_out, model);
+    console() << "\n";
+    n.write_summary(console());
+    console() << "Wrote " << netlist_out << ".bristol and " << netlist_out << ".blif" << std::endl;
+}
+
+// At exit or stop: a counter 0 region still being recorded is saved as far
+// as it got, rather than lost
+void ZeroLoop::save_open_netlist()
+{
+    if (netlist_target == netlist_counter && netlist_recording())
+    {
+        console() << "\nCounter 0 is still active; its netlist only covers the region up to here" << std::endl;
+        save_netlist(netlist_recorder::end(), "counter0");
+    }
 }
 
-Register ZeroLoop::execute_alu_partial(Register &a, Register &b, std::vector<bit> alu_op)
+Register ZeroLoop::execute_alu_partial(Register &a, Register &b, const std::vector<bit> &alu_op)
 {
     return alu.execute_partial(a, b, alu_op);
 }
@@ -103,6 +339,70 @@ uint32_t register_to_uint_internal(Register &reg)
     return result;
 }
 
+// SIMT batch mode: lanes only share the instruction stream, so a branch
+// decision, jump target or memory address that differs from lane 0's makes
+// the lane follow a path that is not its own. Report it and mark the lane.
+void ZeroLoop::check_lane_divergence(const std::vector<bit> &signal, const char *what)
+{
+    if (simt_lanes <= 1)
+        return;
+
+    std::bitset<bit_slicing> active;
+    for (size_t l = 0; l < simt_lanes; l++)
+        active.set(l);
+
+    std::bitset<bit_slicing> diff;
+    for (const bit &b : signal)
+    {
+        std::bitset<bit_slicing> lanes = b.value_vector();
+        diff |= b.value() ? ~lanes : lanes;
+    }
+    diff &= active;
+
+    if (diff.none())
+        return;
+
+    divergence_events++;
+    std::bitset<bit_slicing> fresh = diff & ~diverged_lanes;
+    if (fresh.any())
+    {
+        console() << "\nSIMT: lanes diverged from lane 0 on " << what
+                  << " at 0x" << std::hex << (pc.read_pc() << 2) << std::dec << ":";
+        for (size_t l = 0; l < simt_lanes; l++)
+        {
+            if (fresh[l])
+                console() << " " << l;
+        }
+        console() << std::endl;
+    }
+    diverged_lanes |= diff;
+}
+
+void ZeroLoop::print_simt_lanes(Register &a0)
+{
+    if (simt_lanes <= 1)
+        return;
+
+    console() << "\nSIMT Lane Results:\n";
+    console() << "-----------------------------\n";
+    console() << std::setw(6) << std::left << "lane"
+              << std::setw(14) << std::left << "exit code"
+              << "diverged\n";
+    for (size_t l = 0; l < simt_lanes; l++)
+    {
+        int32_t exit_code = 0;
+        for (size_t i = 0; i < a0.width() && i < 32; i++)
+        {
+            if (a0.at(i).lane(l))
+                exit_code |= (1 << i);
+        }
+        console() << std::setw(6) << std::left << l
+                  << std::setw(14) << std::left << exit_code
+                  << (diverged_lanes[l] ? "yes" : "no") << "\n";
+    }
+    console() << "Divergence events: " << divergence_events << std::endl;
+}
+
 // Connect memories, overloaded for vector<uint32_t> and RAM
 void ZeroLoop::connect_memories(vector<uint32_t> *instr_mem, RAM *data_mem)
 {
@@ -138,12 +438,15 @@ void ZeroLoop::subtract(Register &result, Register a, Register b)
     alu.subtract(result, a, b);
 }
 
-Register ZeroLoop::conditional_memory_read(const bit &should_read, const std::vector<bit> &addr, std::vector<bit> f3_bits)
+Register ZeroLoop::conditional_memory_read(const bit &should_read, const std::vector<bit> &addr, const std::vector<bit> &f3_bits)
 {
+    GATE_SCOPE("memory");
     Register result(32);
 
     if (should_read.value() && data_memory != nullptr)
     {
+        check_lane_divergence(addr, "load address");
+
         // Convert byte address to uint32_t
         uint32_t byte_addr_uint = 0;
         for (size_t i = 0; i < addr.size() && i < 32; ++i)
@@ -291,10 +594,13 @@ Register ZeroLoop::conditional_memory_read(const bit &should_read, const std::ve
 
 Register ZeroLoop::conditional_memory_read(const bit &should_read, const std::vector<bit> &addr, uint32_t f3_bits)
 {
+    GATE_SCOPE("memory");
     Register result(32);
 
     if (should_read.value() && data_memory != nullptr)
     {
+        check_lane_divergence(addr, "load address");
+
         // Convert byte address to uint32_t
         uint32_t byte_addr_uint = 0;
         for (size_t i = 0; i < addr.size() && i < 32; ++i)
@@ -424,243 +730,105 @@ Register ZeroLoop::conditional_memory_read(const bit &should_read, const std::ve
     return result;
 }
 
-// terrible, terrible code, but I don't want to break already working code
-// this should be a temporal overload of the function
-void ZeroLoop::conditional_memory_write(const bit &should_write, const std::vector<bit> &addr, const std::vector<bit> &data, uint32_t f3_bits)
+// Stores the low nbytes bytes of data at byte address addr. Every word the
+// store touches gets one masked write with its byte-enables set, so the old
+// word is only read at the selected leaf of the RAM; a full aligned word is
+// a plain write, and a store that straddles two words writes both.
+void ZeroLoop::store_bytes(const std::vector<bit> &addr, const std::vector<bit> &data, uint32_t nbytes)
 {
+    check_lane_divergence(addr, "store address");
 
-    // Assign bits based on direct comparison
-    bit is_sb(f3_bits == 0); // SB: 000
-    bit is_sh(f3_bits == 1); // SH: 001
-    bit is_sw(f3_bits == 2); // SW: 010
-
-    if (should_write.value() && data_memory != nullptr)
+    // Convert byte address to uint32_t
+    uint32_t byte_addr_uint = 0;
+    for (size_t i = 0; i < addr.size() && i < 32; ++i)
     {
-        // Convert byte address to uint32_t
-        uint32_t byte_addr_uint = 0;
-        for (size_t i = 0; i < addr.size() && i < 32; ++i)
+        if (addr[i].value())
         {
-            if (addr[i].value())
-            {
-                byte_addr_uint |= (1 << i);
-            }
+            byte_addr_uint |= (1 << i);
         }
+    }
 
-        // Adjust for data memory base address
-        byte_addr_uint = byte_addr_uint - DATA_MEM_BASE;
-
-        // Calculate word address and byte offset
-        uint32_t word_addr_uint = byte_addr_uint >> 2;
-        uint32_t offset = byte_addr_uint & 0x3;
-
-        // Convert word address to bits
-        std::vector<bit> word_addr = addr_to_bits(word_addr_uint, data_memory->get_addr_bits());
+    // Adjust for data memory base address
+    byte_addr_uint = byte_addr_uint - DATA_MEM_BASE;
 
-        // Read current word from memory
-        std::vector<bit> current_word = data_memory->read(word_addr);
-        std::vector<bit> next_word;
-        bool write_next_word = false;
+    // Calculate word address and byte offset
+    uint32_t word_addr_uint = byte_addr_uint >> 2;
+    uint32_t offset = byte_addr_uint & 0x3;
 
-        // Handle unaligned accesses that cross word boundaries
-        if ((is_sh.value() && offset == 3) || (is_sw.value() && offset != 0))
-        {
-            next_word = data_memory->read(addr_to_bits(word_addr_uint + 1, data_memory->get_addr_bits()));
-            write_next_word = true;
-        }
+    for (uint32_t word = 0; word < 2; ++word)
+    {
+        std::vector<bit> word_data(32, bit(0));
+        std::vector<bit> enable(4, bit(0));
+        uint32_t enabled = 0;
 
-        // Merge new data into current word
-        if (is_sb.value())
+        for (uint32_t byte = 0; byte < nbytes; ++byte)
         {
-            // Store byte: replace relevant 8 bits
-            size_t start_bit = offset * 8;
+            uint32_t pos = offset + byte;
+            if (pos / 4 != word)
+                continue;
+            enable[pos % 4] = bit(1);
             for (size_t i = 0; i < 8; ++i)
             {
-                if (start_bit + i < current_word.size())
-                {
-                    current_word[start_bit + i] = data[i];
-                }
-            }
-        }
-        else if (is_sh.value())
-        {
-            // Store halfword: replace relevant 16 bits
-            if (offset <= 2)
-            {
-                size_t start_bit = offset * 8;
-                for (size_t i = 0; i < 16; ++i)
-                {
-                    if (start_bit + i < current_word.size())
-                    {
-                        current_word[start_bit + i] = data[i];
-                    }
-                }
-            }
-            else
-            {
-                // Handle cross-word boundary
-                for (size_t i = 0; i < 8; ++i)
-                {
-                    current_word[24 + i] = data[i]; // Last byte of current word
-                    next_word[i] = data[i + 8];     // First byte of next word
-                }
-                write_next_word = true;
-            }
-        }
-        else if (is_sw.value())
-        {
-            // Store word
-            if (offset == 0)
-            {
-                current_word = data;
-            }
-            else
-            {
-                // Handle unaligned word storage
-                size_t bits_in_current = (4 - offset) * 8;
-                for (size_t i = 0; i < bits_in_current; ++i)
-                {
-                    current_word[offset * 8 + i] = data[i];
-                }
-                for (size_t i = 0; i < (32 - bits_in_current); ++i)
-                {
-                    next_word[i] = data[bits_in_current + i];
-                }
-                write_next_word = true;
+                word_data[(pos % 4) * 8 + i] = data[byte * 8 + i];
             }
+            ++enabled;
         }
 
-        // Write modified words back to memory
-        data_memory->write(word_addr, current_word);
-        if (write_next_word)
-        {
-            data_memory->write(addr_to_bits(word_addr_uint + 1, data_memory->get_addr_bits()), next_word);
-        }
+        if (enabled == 0)
+            continue;
+
+        std::vector<bit> word_addr = addr_to_bits(word_addr_uint + word, data_memory->get_addr_bits());
+        if (enabled == 4)
+            data_memory->write(word_addr, word_data);
+        else
+            data_memory->write_masked(word_addr, word_data, enable);
     }
 }
 
-void ZeroLoop::conditional_memory_write(const bit &should_write, const std::vector<bit> &addr, const std::vector<bit> &data, std::vector<bit> f3_bits)
+// terrible, terrible code, but I don't want to break already working code
+// this should be a temporal overload of the function
+void ZeroLoop::conditional_memory_write(const bit &should_write, const std::vector<bit> &addr, const std::vector<bit> &data, uint32_t f3_bits)
 {
+    GATE_SCOPE("memory");
+
+    // Assign bits based on direct comparison
+    bit is_sb(f3_bits == 0); // SB: 000
+    bit is_sh(f3_bits == 1); // SH: 001
+    bit is_sw(f3_bits == 2); // SW: 010
+
+    if (should_write.value() && data_memory != nullptr)
+    {
+        store_bytes(addr, data, is_sb.value() ? 1 : is_sh.value() ? 2 : is_sw.value() ? 4 : 0);
+    }
+}
+
+void ZeroLoop::conditional_memory_write(const bit &should_write, const std::vector<bit> &addr, const std::vector<bit> &data, const std::vector<bit> &f3_bits)
+{
+    GATE_SCOPE("memory");
     bit is_sb = ~f3_bits[2] & ~f3_bits[1] & ~f3_bits[0];
     bit is_sh = ~f3_bits[2] & ~f3_bits[1] & f3_bits[0];
     bit is_sw = ~f3_bits[2] & f3_bits[1] & ~f3_bits[0];
 
     if (should_write.value() && data_memory != nullptr)
     {
-        // Convert byte address to uint32_t
-        uint32_t byte_addr_uint = 0;
-        for (size_t i = 0; i < addr.size() && i < 32; ++i)
-        {
-            if (addr[i].value())
-            {
-                byte_addr_uint |= (1 << i);
-            }
-        }
-
-        // Adjust for data memory base address
-        byte_addr_uint = byte_addr_uint - DATA_MEM_BASE;
-
-        // Calculate word address and byte offset
-        uint32_t word_addr_uint = byte_addr_uint >> 2;
-        uint32_t offset = byte_addr_uint & 0x3;
-
-        // Convert word address to bits
-        std::vector<bit> word_addr = addr_to_bits(word_addr_uint, data_memory->get_addr_bits());
-
-        // Read current word from memory
-        std::vector<bit> current_word = data_memory->read(word_addr);
-        std::vector<bit> next_word;
-        bool write_next_word = false;
-
-        // Handle unaligned accesses that cross word boundaries
-        if ((is_sh.value() && offset == 3) || (is_sw.value() && offset != 0))
-        {
-            next_word = data_memory->read(addr_to_bits(word_addr_uint + 1, data_memory->get_addr_bits()));
-            write_next_word = true;
-        }
-
-        // Merge new data into current word
-        if (is_sb.value())
-        {
-            // Store byte: replace relevant 8 bits
-            size_t start_bit = offset * 8;
-            for (size_t i = 0; i < 8; ++i)
-            {
-                if (start_bit + i < current_word.size())
-                {
-                    current_word[start_bit + i] = data[i];
-                }
-            }
-        }
-        else if (is_sh.value())
-        {
-            // Store halfword: replace relevant 16 bits
-            if (offset <= 2)
-            {
-                size_t start_bit = offset * 8;
-                for (size_t i = 0; i < 16; ++i)
-                {
-                    if (start_bit + i < current_word.size())
-                    {
-                        current_word[start_bit + i] = data[i];
-                    }
-                }
-            }
-            else
-            {
-                // Handle cross-word boundary
-                for (size_t i = 0; i < 8; ++i)
-                {
-                    current_word[24 + i] = data[i]; // Last byte of current word
-                    next_word[i] = data[i + 8];     // First byte of next word
-                }
-                write_next_word = true;
-            }
-        }
-        else if (is_sw.value())
-        {
-            // Store word
-            if (offset == 0)
-            {
-                current_word = data;
-            }
-            else
-            {
-                // Handle unaligned word storage
-                size_t bits_in_current = (4 - offset) * 8;
-                for (size_t i = 0; i < bits_in_current; ++i)
-                {
-                    current_word[offset * 8 + i] = data[i];
-                }
-                for (size_t i = 0; i < (32 - bits_in_current); ++i)
-                {
-                    next_word[i] = data[bits_in_current + i];
-                }
-                write_next_word = true;
-            }
-        }
-
-        // Write modified words back to memory
-        data_memory->write(word_addr, current_word);
-        if (write_next_word)
-        {
-            data_memory->write(addr_to_bits(word_addr_uint + 1, data_memory->get_addr_bits()), next_word);
-        }
+        store_bytes(addr, data, is_sb.value() ? 1 : is_sh.value() ? 2 : is_sw.value() ? 4 : 0);
     }
 }
 
 void ZeroLoop::conditional_register_write(const bit &should_write, size_t rd, const Register &data)
 {
-    if (should_write.value() && rd != 0)
-    {
-        write_register(rd, data);
-    }
+    conditional_register_write(should_write.value(), rd, data);
 }
 
 void ZeroLoop::conditional_register_write(const bool should_write, size_t rd, const Register &data)
 {
     if (should_write && rd != 0)
     {
-        write_register(rd, data);
+        // One destination per instruction; a later write to it replaces an earlier one
+        assert(!pending.reg_write || pending.rd == rd);
+        pending.reg_write = true;
+        pending.rd = rd;
+        pending.reg_value = data;
     }
 }
 
@@ -668,10 +836,49 @@ void ZeroLoop::conditional_csr_write(const bit &should_write, size_t csr_pos, co
 {
     if (should_write.value() && csr_pos != 0)
     {
-        csrs[csr_pos] = data;
+        pending.csr_write = true;
+        pending.csr_pos = csr_pos;
+        pending.csr_value = data;
     }
 }
 
+void ZeroLoop::set_next_pc(uint32_t new_pc)
+{
+    pending.pc_write = true;
+    pending.pc_value = new_pc;
+}
+
+void ZeroLoop::commit()
+{
+    GATE_SCOPE("writeback");
+    retired += 1;
+    if (pending.reg_write)
+    {
+        write_register(pending.rd, pending.reg_value);
+        pending.reg_write = false;
+    }
+    if (pending.csr_write)
+    {
+        csrs[pending.csr_pos] = pending.csr_value;
+        pending.csr_write = false;
+    }
+    if (pending.pc_write)
+    {
+        pc.update_pc_brj(pending.pc_value);
+        pending.pc_write = false;
+    }
+}
+
+void ZeroLoop::stop(run_status status, const std::string &reason)
+{
+    console() << "\nProgram stopped (" << run_status_name(status) << "): " << reason << std::endl;
+    save_open_netlist();
+    RunReport r = save_report(status, 0);
+    save_profile();
+    print_details();
+    throw run_finished{r};
+}
+
 void ZeroLoop::handle_syscall()
 {
     // Get syscall number from a7 (x17)
@@ -679,31 +886,44 @@ void ZeroLoop::handle_syscall()
     Register a0 = read_register(10); // a0 is x10
 
     int syscall_num = register_to_int_internal(a7);
+    check_lane_divergence(a7.get_data(), "syscall number");
 
     switch (syscall_num)
     {
     case 1: // SYS_PRINT_CHAR
     {
         char c = (char)register_to_int_internal(a0);
-        std::cout << c;
-        std::cout.flush();
+        console() << c;
+        console().flush();
     }
     break;
     case 93: // SYS_EXIT
     {
         int exit_code = register_to_int_internal(a0);
-        std::cout << "\nProgram exited with code " << exit_code << std::endl;
+        console() << "\nProgram exited with code " << exit_code << std::endl;
+        print_simt_lanes(a0);
+        save_open_netlist();
+        RunReport r = save_report(run_exited, exit_code);
+        // the exiting ecall does not reach commit, so the PC has not moved on
+        profile_end(0x00000073);
+        save_profile();
         print_details();
-        std::cout<<"\n The CPU itself (without counting memory interactions) took: "<< total_cpu_gate_count << " gates" << std::endl;
-        exit(0);
+        console()<<"\n The CPU itself (without counting memory interactions) took: "<< bit_cost_model::primary().cost(total_cpu_gate_count) << " gates" << std::endl;
+        throw run_finished{r};
     }
 
     case 0: // SYS_EXIT
     {
         int exit_code = register_to_int_internal(a0);
-        std::cout << "\nProgram exited with code " << exit_code << std::endl;
+        console() << "\nProgram exited with code " << exit_code << std::endl;
+        print_simt_lanes(a0);
+        save_open_netlist();
+        RunReport r = save_report(run_exited, exit_code);
+        // the exiting ecall does not reach commit, so the PC has not moved on
+        profile_end(0x00000073);
+        save_profile();
         print_details();
-        exit(0);
+        throw run_finished{r};
     }
     break;
     }
@@ -730,12 +950,13 @@ Register sign_extend_offset(int32_t offset, size_t bits)
 
 void ZeroLoop::execute_instruction_with_decoder_optimized(uint32_t instruction)
 {
-    bigint current_instruction_gate_count_start = bit::ops();
+    GATE_SCOPE("instruction");
+    bit_ops_counts current_instruction_gate_count_start = bit::counts();
 
     // End counter
     check_for_counter(instruction, 1);
 
-    auto decoded = decoder.decode(instruction);
+    const Decoder::DecodedInstruction &decoded = decoder.decode_cached(pc.read_pc(), instruction);
 
     Register rs1 = read_register(decoded.rs1);
     Register rs2 = read_register(decoded.rs2);
@@ -750,12 +971,14 @@ void ZeroLoop::execute_instruction_with_decoder_optimized(uint32_t instruction)
 
     Register alu_result = execute_alu(rs1, alu_input_2, decoded.alu_op);
 
+    // The plug-in units only compute for custom-0 instructions; any other
+    // one is charged what the idle policy says. Under "last", that is
+    // nothing until the first custom-0 instruction has run the units.
     Register plug_in_result(0, 32);
-    bigint start_count_mult = bit::ops();
-    plug_in_result = execute_plug_in_unit(plug_in_result, rs1, alu_input_2, decoded.funct3, decoded.funct7, decoded.opcode);
-    bigint end_count_mult = bit::ops();
-
-    // std::cout<<"MULT TOOK: "<<std::dec<<end_count_mult - start_count_mult<<std::endl;
+    if (decoded.is_custom || plugin_idle.policy == plugin_idle_evaluate)
+        plug_in_result = execute_plug_in_unit(plug_in_result, rs1, alu_input_2, decoded.funct3, decoded.funct7, decoded.opcode);
+    else
+        charge_idle_plug_in_unit();
 
     bit is_zero = 1; // Assume result is zero
     for (size_t i = 0; i < 32; i++)
@@ -771,9 +994,13 @@ void ZeroLoop::execute_instruction_with_decoder_optimized(uint32_t instruction)
                         (decoded.is_blt & is_rs1_lesser_rs2) | (decoded.is_bge & ~is_rs1_lesser_rs2) |
                         (decoded.is_bltu & is_rs1_lesser_rs2) | (decoded.is_bgeu & ~is_rs1_lesser_rs2);
     should_branch &= bit(decoded.is_branch);
+    if (decoded.is_branch)
+    {
+        check_lane_divergence({should_branch}, "branch");
+    }
 
     // We measure up to when memory operations occur. Stop until these are done.
-    bigint current_instruction_gate_count_stop = bit::ops();
+    bit_ops_counts current_instruction_gate_count_stop = bit::counts();
     total_cpu_gate_count += current_instruction_gate_count_stop - current_instruction_gate_count_start;
 
     // Memory operations
@@ -785,9 +1012,13 @@ void ZeroLoop::execute_instruction_with_decoder_optimized(uint32_t instruction)
     }
     conditional_memory_write(bit(decoded.is_store), mem_addr, rs2.get_data(), decoded.f3_bits);
 
-    current_instruction_gate_count_start = bit::ops();
+    current_instruction_gate_count_start = bit::counts();
 
     // JALR target calculation
+    if (decoded.is_jalr)
+    {
+        check_lane_divergence(alu_result.get_data(), "jalr target");
+    }
     Register jalr_target_byte(alu_result);
     jalr_target_byte.at(0) = bit(0);
     Register jalr_target_word(jalr_target_byte.get_data_uint() >> 2, 32);
@@ -803,7 +1034,7 @@ void ZeroLoop::execute_instruction_with_decoder_optimized(uint32_t instruction)
     if (instruction == 0x00000073)
     { // Syscall detection
         handle_syscall();
-        pc.update_pc_brj(next_pc.get_data_uint());
+        set_next_pc(next_pc.get_data_uint());
         return;
     }
 
@@ -816,16 +1047,15 @@ void ZeroLoop::execute_instruction_with_decoder_optimized(uint32_t instruction)
     bit is_auipc = bit(decoded.auipc);
 
     // Final PC selection
-    Register final_pc(32);
-    for (size_t i = 0; i < 32; i++)
     {
-        final_pc.at(i) = next_pc.at(i);
-        final_pc.at(i) = should_branch.mux(final_pc.at(i), branch_target_word.at(i));
-        final_pc.at(i) = bit(decoded.jal).mux(final_pc.at(i), jal_target_word.at(i));
-        final_pc.at(i) = bit(decoded.is_jalr).mux(final_pc.at(i), jalr_target_word.at(i));
-    }
+        GATE_SCOPE("pc");
+        Register final_pc(next_pc);
+        final_pc = Register::mux(should_branch, final_pc, branch_target_word);
+        final_pc = Register::mux(bit(decoded.jal), final_pc, jal_target_word);
+        final_pc = Register::mux(bit(decoded.is_jalr), final_pc, jalr_target_word);
 
-    pc.update_pc_brj(final_pc.get_data_uint());
+        set_next_pc(final_pc.get_data_uint());
+    }
 
     // Register Write Back
     conditional_register_write(decoded.custom, decoded.rd, plug_in_result);
@@ -840,15 +1070,16 @@ void ZeroLoop::execute_instruction_with_decoder_optimized(uint32_t instruction)
     // Start counter
     check_for_counter(instruction, 0);
 
-    current_instruction_gate_count_stop = bit::ops();
+    current_instruction_gate_count_stop = bit::counts();
     total_cpu_gate_count += current_instruction_gate_count_stop - current_instruction_gate_count_start;
 }
 
 
 void ZeroLoop::execute_instruction_without_decoder(uint32_t instruction)
 {
+    GATE_SCOPE("instruction");
 
-    bigint current_instruction_gate_count_start = bit::ops();
+    bit_ops_counts current_instruction_gate_count_start = bit::counts();
 
 
     check_for_counter(instruction,1);
@@ -1004,7 +1235,7 @@ void ZeroLoop::execute_instruction_without_decoder(uint32_t instruction)
     // Memory address calculation
     std::vector<bit> mem_addr_bits = alu_result.get_data();
 
-    bigint current_instruction_gate_count_stop = bit::ops();
+    bit_ops_counts current_instruction_gate_count_stop = bit::counts();
     total_cpu_gate_count += current_instruction_gate_count_stop - current_instruction_gate_count_start;
     
 
@@ -1013,7 +1244,7 @@ void ZeroLoop::execute_instruction_without_decoder(uint32_t instruction)
     conditional_memory_write(is_store, mem_addr_bits, rs2.get_data(), funct3);
 
 
-    current_instruction_gate_count_start = bit::ops();
+    current_instruction_gate_count_start = bit::counts();
 
     // Write back logic
     bool write_alu = !(is_branch || is_store) && (is_imm_op || (opcode == 0x33));
@@ -1046,6 +1277,7 @@ void ZeroLoop::execute_instruction_without_decoder(uint32_t instruction)
     if (is_jalr)
     {
         // JALR: PC = (rs1 + imm) & ~1
+        check_lane_divergence(rs1.get_data(), "jalr target");
         uint32_t target_addr = rs1.get_data_uint() + imm;
         // Clear least significant bit as per spec
         target_addr = target_addr & ~1U;
@@ -1068,14 +1300,14 @@ void ZeroLoop::execute_instruction_without_decoder(uint32_t instruction)
         final_pc = Register(pc_val.get_data_uint() + 1, 32);
     }
 
-    pc.update_pc_brj(final_pc.get_data_uint());
+    set_next_pc(final_pc.get_data_uint());
 
     // print_registers();
 
     check_for_counter(instruction,0);
 
 
-    current_instruction_gate_count_stop = bit::ops();
+    current_instruction_gate_count_stop = bit::counts();
     total_cpu_gate_count += current_instruction_gate_count_stop - current_instruction_gate_count_start;
 
 }